@@ -0,0 +1,138 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace graph {
+
+// Reachability classes of the vertices, computed once in O(V + E) so that a query between
+// vertices no route joins can be answered without searching. A vertex only reaches vertices
+// of its own weakly connected component. Strongly connected components are numbered in the
+// order Tarjan's algorithm completes them, and an edge between two components always leads
+// to one completed earlier, so no route leads to a component with a greater number either.
+template <typename Weight>
+class ConnectedComponents {
+public:
+    ConnectedComponents() = default;
+    explicit ConnectedComponents(const DirectedWeightedGraph<Weight>& graph);
+
+    // false if there is certainly no route from `from` to `to`, true if there may be one.
+    bool MayReach(VertexId from, VertexId to) const;
+
+private:
+    static constexpr uint32_t UNVISITED = static_cast<uint32_t>(-1);
+
+    void FindWeakComponents(const DirectedWeightedGraph<Weight>& graph);
+    void FindStrongComponents(const DirectedWeightedGraph<Weight>& graph);
+
+    // a representative vertex of the weakly connected component of every vertex
+    std::vector<uint32_t> weak_components_;
+    // the Tarjan number of the strongly connected component of every vertex
+    std::vector<uint32_t> strong_components_;
+};
+
+template <typename Weight>
+ConnectedComponents<Weight>::ConnectedComponents(const DirectedWeightedGraph<Weight>& graph) {
+    FindWeakComponents(graph);
+    FindStrongComponents(graph);
+}
+
+template <typename Weight>
+bool ConnectedComponents<Weight>::MayReach(VertexId from, VertexId to) const {
+    return weak_components_[from] == weak_components_[to] && strong_components_[from] >= strong_components_[to];
+}
+
+template <typename Weight>
+void ConnectedComponents<Weight>::FindWeakComponents(const DirectedWeightedGraph<Weight>& graph) {
+    // union-find with path halving; the smaller vertex becomes the root, so roots are stable
+    weak_components_.resize(graph.GetVertexCount());
+    for (VertexId vertex = 0; vertex < weak_components_.size(); ++vertex) {
+        weak_components_[vertex] = static_cast<uint32_t>(vertex);
+    }
+    const auto find_root = [this](uint32_t vertex) {
+        while (weak_components_[vertex] != vertex) {
+            weak_components_[vertex] = weak_components_[weak_components_[vertex]];
+            vertex = weak_components_[vertex];
+        }
+        return vertex;
+    };
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        const uint32_t from_root = find_root(static_cast<uint32_t>(edge.from));
+        const uint32_t to_root = find_root(static_cast<uint32_t>(edge.to));
+        if (from_root != to_root) {
+            weak_components_[std::max(from_root, to_root)] = std::min(from_root, to_root);
+        }
+    }
+    for (VertexId vertex = 0; vertex < weak_components_.size(); ++vertex) {
+        weak_components_[vertex] = find_root(static_cast<uint32_t>(vertex));
+    }
+}
+
+template <typename Weight>
+void ConnectedComponents<Weight>::FindStrongComponents(const DirectedWeightedGraph<Weight>& graph) {
+    const size_t vertex_count = graph.GetVertexCount();
+    strong_components_.assign(vertex_count, UNVISITED);
+
+    // Tarjan's algorithm with an explicit call stack, since routes may be longer than
+    // the native stack allows
+    struct Frame {
+        VertexId vertex;
+        IncidentEdgeIterator next_edge;
+        IncidentEdgeIterator end_edge;
+    };
+    std::vector<uint32_t> visit_order(vertex_count, UNVISITED);
+    std::vector<uint32_t> low_links(vertex_count);
+    std::vector<VertexId> component_stack;
+    std::vector<Frame> frames;
+    uint32_t visited_count = 0;
+    uint32_t component_count = 0;
+
+    const auto visit = [&](VertexId vertex) {
+        visit_order[vertex] = low_links[vertex] = visited_count++;
+        component_stack.push_back(vertex);
+        const auto edges = graph.GetIncidentEdges(vertex);
+        frames.push_back({vertex, edges.begin(), edges.end()});
+    };
+
+    for (VertexId root = 0; root < vertex_count; ++root) {
+        if (visit_order[root] != UNVISITED) {
+            continue;
+        }
+        visit(root);
+        while (!frames.empty()) {
+            auto& frame = frames.back();
+            const VertexId vertex = frame.vertex;
+            if (frame.next_edge != frame.end_edge) {
+                const VertexId next = graph.GetEdge(*frame.next_edge++).to;
+                if (visit_order[next] == UNVISITED) {
+                    visit(next);
+                } else if (strong_components_[next] == UNVISITED) {
+                    // still on the component stack
+                    low_links[vertex] = std::min(low_links[vertex], visit_order[next]);
+                }
+                continue;
+            }
+
+            frames.pop_back();
+            if (!frames.empty()) {
+                const VertexId parent = frames.back().vertex;
+                low_links[parent] = std::min(low_links[parent], low_links[vertex]);
+            }
+            if (low_links[vertex] == visit_order[vertex]) {
+                VertexId member;
+                do {
+                    member = component_stack.back();
+                    component_stack.pop_back();
+                    strong_components_[member] = component_count;
+                } while (member != vertex);
+                ++component_count;
+            }
+        }
+    }
+}
+
+}  // namespace graph
@@ -0,0 +1,586 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "search_state.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Contraction Hierarchies over a DirectedWeightedGraph. Preprocessing contracts the vertices
+// one by one, adding shortcut edges that keep the remaining distances intact; a query is a
+// bidirectional Dijkstra that only climbs to higher-ranked vertices. Shortcuts remember the
+// two edges they replace, so found routes unpack back into the graph's own edge ids.
+template <typename Weight>
+class ContractionHierarchy {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    // Either an edge of the original graph or a shortcut for the pair of edges
+    // from -> contracted vertex -> to.
+    struct HierarchyEdge {
+        VertexId from;
+        VertexId to;
+        Weight weight;
+        EdgeId original_edge;  // NO_EDGE for shortcuts
+        EdgeId first_half;
+        EdgeId second_half;
+    };
+
+    // A hierarchy edge as seen from one of its ends.
+    struct Arc {
+        VertexId vertex;
+        Weight weight;
+        EdgeId edge;
+    };
+
+    // Everything preprocessing computes; enough to answer queries over the same graph.
+    struct Index {
+        std::vector<HierarchyEdge> edges;
+        std::vector<size_t> forward_offsets;
+        std::vector<Arc> forward_arcs;
+        std::vector<size_t> backward_offsets;
+        std::vector<Arc> backward_arcs;
+    };
+
+    explicit ContractionHierarchy(const Graph& graph);
+    // Skips preprocessing and answers queries with an index taken from GetIndex.
+    ContractionHierarchy(const Graph& graph, Index index);
+
+    Index GetIndex() const;
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    // Route weights from every source to every target, row by row; nullopt for unreachable targets.
+    std::vector<std::optional<Weight>> BuildWeightMatrix(
+            const std::vector<VertexId>& sources, const std::vector<VertexId>& targets,
+            parallel::ThreadPool& thread_pool = parallel::DefaultThreadPool()) const;
+
+    // Vertices settled by both directions of the last BuildRoute on the calling thread.
+    static size_t GetLastSettledCount();
+
+private:
+    using SearchState = graph::SearchState<Weight>;
+    static constexpr EdgeId NO_EDGE = SearchState::NO_EDGE;
+
+    // Limits the local searches looking for a path that makes a shortcut unnecessary.
+    // Giving up early only adds a redundant shortcut, never a wrong distance.
+    static constexpr size_t WITNESS_SETTLE_LIMIT = 200;
+    // A priority only estimates the shortcuts: its searches take the witnesses made of a single
+    // arc, which are most of them in the dense part of the graph, and no more.
+    static constexpr size_t ESTIMATE_SETTLE_LIMIT = 10;
+    static constexpr size_t ESTIMATE_HOP_LIMIT = 1;
+    static constexpr size_t NOT_TARGET = std::numeric_limits<size_t>::max();
+
+    // Arcs of the vertices that are not contracted yet. Once a vertex is contracted,
+    // its lists keep exactly the arcs that lead to higher-ranked vertices.
+    struct Workspace {
+        std::vector<std::vector<Arc>> out_arcs;
+        std::vector<std::vector<Arc>> in_arcs;
+        std::vector<size_t> contracted_neighbours;
+        SearchState witness_state;
+        // arcs on the path to each vertex reached by the witness search
+        std::vector<size_t> witness_hops;
+        // the position of each vertex among the heads of the out arcs of the vertex being
+        // contracted, and which of those heads the witness search has a witness for or settled
+        std::vector<size_t> target_positions;
+        std::vector<bool> is_resolved;
+    };
+
+    struct QueryState {
+        SearchState forward;
+        SearchState backward;
+    };
+
+    static QueryState& GetQueryState() {
+        static thread_local QueryState state;
+        return state;
+    }
+
+    void Preprocess(Workspace& workspace);
+
+    // Adds (or, with dry_run, only counts) the shortcuts needed to contract the vertex.
+    size_t ContractVertex(Workspace& workspace, VertexId vertex, bool dry_run);
+
+    int ComputePriority(Workspace& workspace, VertexId vertex);
+
+    // Dijkstra from the tail of the in arc that avoids the contracted vertex and looks for
+    // paths to the heads of its out arcs no heavier than the routes through it. It stops once
+    // every head is settled or has such a path, past the heaviest route through the vertex or
+    // after settle_limit vertices, and does not leave the vertices hop_limit arcs away.
+    void SearchWitnesses(Workspace& workspace, VertexId vertex, const Arc& in_arc, Weight max_out_weight,
+                         size_t settle_limit, size_t hop_limit);
+
+    void AddShortcut(Workspace& workspace, VertexId from, VertexId to, Weight weight,
+                     EdgeId first_half, EdgeId second_half);
+
+    void BuildSearchGraphs(const Workspace& workspace);
+
+    void UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const;
+
+    // Settles everything reachable from start over the given upward arcs, appending
+    // the settled vertices with their weights.
+    void SearchUpward(SearchState& search, VertexId start, const std::vector<size_t>& offsets,
+                      const std::vector<Arc>& arcs, std::vector<std::pair<VertexId, Weight>>& settled) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    std::vector<HierarchyEdge> edges_;
+    // Upward arcs in CSR form: forward_arcs_ hold u -> v, backward_arcs_ hold the
+    // reversed v -> u, each stored at the lower-ranked vertex.
+    std::vector<size_t> forward_offsets_;
+    std::vector<Arc> forward_arcs_;
+    std::vector<size_t> backward_offsets_;
+    std::vector<Arc> backward_arcs_;
+};
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph)
+    : graph_(graph)
+{
+    const size_t vertex_count = graph.GetVertexCount();
+    Workspace workspace;
+    workspace.out_arcs.resize(vertex_count);
+    workspace.in_arcs.resize(vertex_count);
+    workspace.contracted_neighbours.assign(vertex_count, 0);
+    workspace.witness_hops.resize(vertex_count);
+    workspace.target_positions.assign(vertex_count, NOT_TARGET);
+
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        if (edge.from == edge.to) {
+            continue;
+        }
+        auto& out_arcs = workspace.out_arcs[edge.from];
+        auto parallel_arc = std::find_if(out_arcs.begin(), out_arcs.end(), [&edge](const Arc& arc) {
+            return arc.vertex == edge.to;
+        });
+        if (parallel_arc != out_arcs.end()) {
+            if (edge.weight < parallel_arc->weight) {
+                edges_[parallel_arc->edge].weight = edge.weight;
+                edges_[parallel_arc->edge].original_edge = edge_id;
+                parallel_arc->weight = edge.weight;
+                for (auto& arc : workspace.in_arcs[edge.to]) {
+                    if (arc.vertex == edge.from) {
+                        arc.weight = edge.weight;
+                    }
+                }
+            }
+            continue;
+        }
+        const EdgeId id = edges_.size();
+        edges_.push_back({edge.from, edge.to, edge.weight, edge_id, NO_EDGE, NO_EDGE});
+        out_arcs.push_back({edge.to, edge.weight, id});
+        workspace.in_arcs[edge.to].push_back({edge.from, edge.weight, id});
+    }
+
+    Preprocess(workspace);
+    BuildSearchGraphs(workspace);
+}
+
+template <typename Weight>
+ContractionHierarchy<Weight>::ContractionHierarchy(const Graph& graph, Index index)
+    : graph_(graph)
+    , edges_(std::move(index.edges))
+    , forward_offsets_(std::move(index.forward_offsets))
+    , forward_arcs_(std::move(index.forward_arcs))
+    , backward_offsets_(std::move(index.backward_offsets))
+    , backward_arcs_(std::move(index.backward_arcs))
+{
+    const size_t vertex_count = graph.GetVertexCount();
+    const auto arcs_fit = [this, vertex_count](const std::vector<size_t>& offsets, const std::vector<Arc>& arcs) {
+        return offsets.size() == vertex_count + 1 && offsets.front() == 0 && offsets.back() == arcs.size()
+               && std::is_sorted(offsets.begin(), offsets.end())
+               && std::all_of(arcs.begin(), arcs.end(), [this, vertex_count](const Arc& arc) {
+                      return arc.vertex < vertex_count && arc.edge < edges_.size();
+                  });
+    };
+    // shortcuts are added after both of their halves, so unpacking always terminates
+    bool edges_fit = true;
+    for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+        const auto& edge = edges_[edge_id];
+        edges_fit = edges_fit && (edge.original_edge != NO_EDGE
+                                  ? edge.original_edge < graph.GetEdgeCount()
+                                  : edge.first_half < edge_id && edge.second_half < edge_id);
+    }
+    if (!edges_fit || !arcs_fit(forward_offsets_, forward_arcs_) || !arcs_fit(backward_offsets_, backward_arcs_)) {
+        throw std::invalid_argument("Hierarchy index does not match the graph");
+    }
+}
+
+template <typename Weight>
+typename ContractionHierarchy<Weight>::Index ContractionHierarchy<Weight>::GetIndex() const {
+    return {edges_, forward_offsets_, forward_arcs_, backward_offsets_, backward_arcs_};
+}
+
+template <typename Weight>
+size_t ContractionHierarchy<Weight>::GetLastSettledCount() {
+    const QueryState& state = GetQueryState();
+    return state.forward.GetSettledCount() + state.backward.GetSettledCount();
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::Preprocess(Workspace& workspace) {
+    const size_t vertex_count = graph_.GetVertexCount();
+    workspace.witness_state.Prepare(vertex_count);
+
+    // Lazy updates: a popped vertex is contracted only if its refreshed priority
+    // is still not worse than the best one left in the queue.
+    using QueueItem = std::pair<int, VertexId>;
+    std::vector<QueueItem> queue;
+    queue.reserve(vertex_count);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        queue.emplace_back(ComputePriority(workspace, vertex), vertex);
+    }
+    std::make_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+
+    while (!queue.empty()) {
+        std::pop_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+        const VertexId vertex = queue.back().second;
+        queue.pop_back();
+
+        const int priority = ComputePriority(workspace, vertex);
+        if (!queue.empty() && priority > queue.front().first) {
+            queue.emplace_back(priority, vertex);
+            std::push_heap(queue.begin(), queue.end(), std::greater<QueueItem>{});
+            continue;
+        }
+
+        ContractVertex(workspace, vertex, false);
+        for (const auto& arc : workspace.out_arcs[vertex]) {
+            ++workspace.contracted_neighbours[arc.vertex];
+            auto& in_arcs = workspace.in_arcs[arc.vertex];
+            in_arcs.erase(std::remove_if(in_arcs.begin(), in_arcs.end(), [vertex](const Arc& other) {
+                return other.vertex == vertex;
+            }), in_arcs.end());
+        }
+        for (const auto& arc : workspace.in_arcs[vertex]) {
+            ++workspace.contracted_neighbours[arc.vertex];
+            auto& out_arcs = workspace.out_arcs[arc.vertex];
+            out_arcs.erase(std::remove_if(out_arcs.begin(), out_arcs.end(), [vertex](const Arc& other) {
+                return other.vertex == vertex;
+            }), out_arcs.end());
+        }
+    }
+}
+
+template <typename Weight>
+int ContractionHierarchy<Weight>::ComputePriority(Workspace& workspace, VertexId vertex) {
+    const size_t shortcut_count = ContractVertex(workspace, vertex, true);
+    const size_t removed_count = workspace.in_arcs[vertex].size() + workspace.out_arcs[vertex].size();
+    return static_cast<int>(shortcut_count) - static_cast<int>(removed_count)
+           + static_cast<int>(workspace.contracted_neighbours[vertex]);
+}
+
+template <typename Weight>
+size_t ContractionHierarchy<Weight>::ContractVertex(Workspace& workspace, VertexId vertex, bool dry_run) {
+    const auto& out_arcs = workspace.out_arcs[vertex];
+    if (out_arcs.empty()) {
+        return 0;
+    }
+    Weight max_out_weight = ZERO_WEIGHT;
+    for (size_t position = 0; position < out_arcs.size(); ++position) {
+        max_out_weight = std::max(max_out_weight, out_arcs[position].weight);
+        workspace.target_positions[out_arcs[position].vertex] = position;
+    }
+
+    // Shortcuts only touch the lists of the neighbours, so iterating the vertex's own lists is safe.
+    size_t shortcut_count = 0;
+    for (const auto& in_arc : workspace.in_arcs[vertex]) {
+        const VertexId source = in_arc.vertex;
+        if (dry_run) {
+            SearchWitnesses(workspace, vertex, in_arc, max_out_weight, ESTIMATE_SETTLE_LIMIT, ESTIMATE_HOP_LIMIT);
+        } else {
+            SearchWitnesses(workspace, vertex, in_arc, max_out_weight, WITNESS_SETTLE_LIMIT,
+                            std::numeric_limits<size_t>::max());
+        }
+
+        const auto& state = workspace.witness_state;
+        for (const auto& out_arc : out_arcs) {
+            const VertexId target = out_arc.vertex;
+            const Weight shortcut_weight = in_arc.weight + out_arc.weight;
+            if (target == source || (state.IsReached(target) && !(shortcut_weight < state.GetWeight(target)))) {
+                continue;
+            }
+            ++shortcut_count;
+            if (!dry_run) {
+                AddShortcut(workspace, source, target, shortcut_weight, in_arc.edge, out_arc.edge);
+            }
+        }
+    }
+    for (const auto& arc : out_arcs) {
+        workspace.target_positions[arc.vertex] = NOT_TARGET;
+    }
+    return shortcut_count;
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::SearchWitnesses(Workspace& workspace, VertexId vertex, const Arc& in_arc,
+                                                   Weight max_out_weight, size_t settle_limit, size_t hop_limit) {
+    const auto& out_arcs = workspace.out_arcs[vertex];
+    auto& is_resolved = workspace.is_resolved;
+    is_resolved.assign(out_arcs.size(), false);
+    size_t unresolved_count = out_arcs.size();
+    // a target is resolved once it has a witness or is settled without one
+    const auto resolve = [&](VertexId target) {
+        const size_t position = workspace.target_positions[target];
+        if (position != NOT_TARGET && !is_resolved[position]) {
+            is_resolved[position] = true;
+            --unresolved_count;
+        }
+    };
+    // the source needs no shortcut to itself
+    resolve(in_arc.vertex);
+
+    auto& state = workspace.witness_state;
+    state.Prepare(graph_.GetVertexCount());
+    state.Relax(in_arc.vertex, ZERO_WEIGHT, NO_EDGE);
+    workspace.witness_hops[in_arc.vertex] = 0;
+    const Weight limit = in_arc.weight + max_out_weight;
+    size_t settled_count = 0;
+    typename SearchState::QueueItem item;
+    while (unresolved_count > 0 && settled_count++ < settle_limit && state.PopSettled(item)) {
+        if (limit < item.weight) {
+            break;
+        }
+        resolve(item.vertex);
+        const size_t hops = workspace.witness_hops[item.vertex] + 1;
+        if (hops > hop_limit) {
+            continue;
+        }
+        for (const auto& arc : workspace.out_arcs[item.vertex]) {
+            if (arc.vertex == vertex || !state.Relax(arc.vertex, item.weight + arc.weight, arc.edge)) {
+                continue;
+            }
+            workspace.witness_hops[arc.vertex] = hops;
+            const size_t position = workspace.target_positions[arc.vertex];
+            if (position != NOT_TARGET && !(in_arc.weight + out_arcs[position].weight < item.weight + arc.weight)) {
+                resolve(arc.vertex);
+            }
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::AddShortcut(Workspace& workspace, VertexId from, VertexId to, Weight weight,
+                                               EdgeId first_half, EdgeId second_half) {
+    auto& out_arcs = workspace.out_arcs[from];
+    auto existing_arc = std::find_if(out_arcs.begin(), out_arcs.end(), [to](const Arc& arc) {
+        return arc.vertex == to;
+    });
+    if (existing_arc != out_arcs.end() && !(weight < existing_arc->weight)) {
+        return;
+    }
+
+    const EdgeId id = edges_.size();
+    edges_.push_back({from, to, weight, NO_EDGE, first_half, second_half});
+    if (existing_arc == out_arcs.end()) {
+        out_arcs.push_back({to, weight, id});
+        workspace.in_arcs[to].push_back({from, weight, id});
+        return;
+    }
+    *existing_arc = {to, weight, id};
+    for (auto& arc : workspace.in_arcs[to]) {
+        if (arc.vertex == from) {
+            arc = {from, weight, id};
+        }
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::BuildSearchGraphs(const Workspace& workspace) {
+    const size_t vertex_count = graph_.GetVertexCount();
+    forward_offsets_.assign(vertex_count + 1, 0);
+    backward_offsets_.assign(vertex_count + 1, 0);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        forward_offsets_[vertex + 1] = forward_offsets_[vertex] + workspace.out_arcs[vertex].size();
+        backward_offsets_[vertex + 1] = backward_offsets_[vertex] + workspace.in_arcs[vertex].size();
+        forward_arcs_.insert(forward_arcs_.end(), workspace.out_arcs[vertex].begin(), workspace.out_arcs[vertex].end());
+        backward_arcs_.insert(backward_arcs_.end(), workspace.in_arcs[vertex].begin(), workspace.in_arcs[vertex].end());
+    }
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::UnpackEdge(EdgeId edge_id, std::vector<EdgeId>& edges) const {
+    std::vector<EdgeId> stack{edge_id};
+    while (!stack.empty()) {
+        const auto& edge = edges_[stack.back()];
+        stack.pop_back();
+        if (edge.original_edge != NO_EDGE) {
+            edges.push_back(edge.original_edge);
+        } else {
+            stack.push_back(edge.second_half);
+            stack.push_back(edge.first_half);
+        }
+    }
+}
+
+template <typename Weight>
+std::optional<typename ContractionHierarchy<Weight>::RouteInfo>
+ContractionHierarchy<Weight>::BuildRoute(VertexId from, VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    QueryState& state = GetQueryState();
+    state.forward.Prepare(vertex_count);
+    state.backward.Prepare(vertex_count);
+    state.forward.Relax(from, ZERO_WEIGHT, NO_EDGE);
+    state.backward.Relax(to, ZERO_WEIGHT, NO_EDGE);
+
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+    const auto search_step = [&](SearchState& search, const SearchState& other_search,
+                                 const std::vector<size_t>& offsets, const std::vector<Arc>& arcs) {
+        typename SearchState::QueueItem item;
+        if (!search.PopSettled(item)) {
+            return;
+        }
+        if (best_weight && !(item.weight < *best_weight)) {
+            search.ClearQueue();
+            return;
+        }
+        if (other_search.IsReached(item.vertex)) {
+            const Weight weight = item.weight + other_search.GetWeight(item.vertex);
+            if (!best_weight || weight < *best_weight) {
+                best_weight = weight;
+                meeting_vertex = item.vertex;
+            }
+        }
+        for (size_t i = offsets[item.vertex]; i < offsets[item.vertex + 1]; ++i) {
+            search.Relax(arcs[i].vertex, item.weight + arcs[i].weight, arcs[i].edge);
+        }
+    };
+
+    while (!state.forward.IsQueueEmpty() || !state.backward.IsQueueEmpty()) {
+        const bool forward_turn = state.backward.IsQueueEmpty()
+                                  || (!state.forward.IsQueueEmpty()
+                                      && !(state.backward.Top().key < state.forward.Top().key));
+        if (forward_turn) {
+            search_step(state.forward, state.backward, forward_offsets_, forward_arcs_);
+        } else {
+            search_step(state.backward, state.forward, backward_offsets_, backward_arcs_);
+        }
+    }
+    if (!best_weight) {
+        return std::nullopt;
+    }
+
+    std::vector<EdgeId> hierarchy_edges;
+    for (EdgeId edge_id = state.forward.GetPrevEdge(meeting_vertex); edge_id != NO_EDGE;
+         edge_id = state.forward.GetPrevEdge(edges_[edge_id].from))
+    {
+        hierarchy_edges.push_back(edge_id);
+    }
+    std::reverse(hierarchy_edges.begin(), hierarchy_edges.end());
+    for (EdgeId edge_id = state.backward.GetPrevEdge(meeting_vertex); edge_id != NO_EDGE;
+         edge_id = state.backward.GetPrevEdge(edges_[edge_id].to))
+    {
+        hierarchy_edges.push_back(edge_id);
+    }
+
+    Weight weight = ZERO_WEIGHT;
+    std::vector<EdgeId> edges;
+    for (const EdgeId edge_id : hierarchy_edges) {
+        UnpackEdge(edge_id, edges);
+    }
+    for (const EdgeId edge_id : edges) {
+        weight += graph_.GetEdge(edge_id).weight;
+    }
+
+    return RouteInfo{weight, std::move(edges)};
+}
+
+template <typename Weight>
+void ContractionHierarchy<Weight>::SearchUpward(SearchState& search, VertexId start,
+                                                const std::vector<size_t>& offsets, const std::vector<Arc>& arcs,
+                                                std::vector<std::pair<VertexId, Weight>>& settled) const {
+    search.Prepare(graph_.GetVertexCount());
+    search.Relax(start, ZERO_WEIGHT, NO_EDGE);
+    typename SearchState::QueueItem item;
+    while (search.PopSettled(item)) {
+        settled.emplace_back(item.vertex, item.weight);
+        for (size_t i = offsets[item.vertex]; i < offsets[item.vertex + 1]; ++i) {
+            search.Relax(arcs[i].vertex, item.weight + arcs[i].weight, arcs[i].edge);
+        }
+    }
+}
+
+// Bucket-based many-to-many: the upward search space of every target is stored in buckets
+// at the vertices it settles, then the upward search of every source meets them there.
+// Upward search spaces are small, so both phases run them to exhaustion, in parallel.
+template <typename Weight>
+std::vector<std::optional<Weight>> ContractionHierarchy<Weight>::BuildWeightMatrix(
+        const std::vector<VertexId>& sources, const std::vector<VertexId>& targets,
+        parallel::ThreadPool& thread_pool) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    const auto is_out_of_range = [vertex_count](VertexId vertex) {
+        return vertex >= vertex_count;
+    };
+    if (std::any_of(sources.begin(), sources.end(), is_out_of_range)
+        || std::any_of(targets.begin(), targets.end(), is_out_of_range)) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    std::vector<std::vector<std::pair<VertexId, Weight>>> target_spaces(targets.size());
+    thread_pool.ParallelFor(targets.size(), [&](size_t target_index) {
+        SearchUpward(GetQueryState().backward, targets[target_index], backward_offsets_, backward_arcs_,
+                     target_spaces[target_index]);
+    });
+
+    struct BucketEntry {
+        size_t target_index;
+        Weight weight;
+    };
+    std::vector<size_t> bucket_offsets(vertex_count + 1, 0);
+    for (const auto& target_space : target_spaces) {
+        for (const auto& [vertex, weight] : target_space) {
+            ++bucket_offsets[vertex + 1];
+        }
+    }
+    std::partial_sum(bucket_offsets.begin(), bucket_offsets.end(), bucket_offsets.begin());
+    std::vector<BucketEntry> buckets(bucket_offsets.back());
+    {
+        std::vector<size_t> positions(bucket_offsets.begin(), bucket_offsets.end() - 1);
+        for (size_t target_index = 0; target_index < targets.size(); ++target_index) {
+            for (const auto& [vertex, weight] : target_spaces[target_index]) {
+                buckets[positions[vertex]++] = {target_index, weight};
+            }
+        }
+    }
+
+    std::vector<std::optional<Weight>> weights(sources.size() * targets.size());
+    thread_pool.ParallelFor(sources.size(), [&](size_t source_index) {
+        std::vector<std::pair<VertexId, Weight>> source_space;
+        SearchUpward(GetQueryState().forward, sources[source_index], forward_offsets_, forward_arcs_, source_space);
+        auto* row = weights.data() + source_index * targets.size();
+        for (const auto& [vertex, weight] : source_space) {
+            for (size_t i = bucket_offsets[vertex]; i < bucket_offsets[vertex + 1]; ++i) {
+                auto& cell = row[buckets[i].target_index];
+                const Weight candidate = weight + buckets[i].weight;
+                if (!cell || candidate < *cell) {
+                    cell = candidate;
+                }
+            }
+        }
+    });
+    return weights;
+}
+
+}  // namespace graph
@@ -0,0 +1,336 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "search_state.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Answers BuildRoute with a per-query search instead of an all-pairs table,
+// so only the graph itself stays resident.
+template <typename Weight>
+class DijkstraRouter {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    enum class SearchMode {
+        DIJKSTRA,
+        BIDIRECTIONAL,  // searches from both ends over a reversed copy of the incidence lists
+        A_STAR          // goal-directed by the lower bound passed to the constructor
+    };
+
+    // Lower bound of the distance between two vertices. It has to be consistent:
+    // lower_bound(u, t) <= weight(u -> v) + lower_bound(v, t) for every edge.
+    using LowerBound = std::function<Weight(VertexId from, VertexId to)>;
+
+    explicit DijkstraRouter(const Graph& graph, SearchMode mode = SearchMode::DIJKSTRA,
+                            LowerBound lower_bound = {});
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    // Route weights from every source to every target, row by row; nullopt for unreachable targets.
+    // One forward search per source, whatever the mode, stopping once all the targets are settled.
+    // Sources are searched in parallel.
+    std::vector<std::optional<Weight>> BuildWeightMatrix(
+            const std::vector<VertexId>& sources, const std::vector<VertexId>& targets,
+            parallel::ThreadPool& thread_pool = parallel::DefaultThreadPool()) const;
+
+    // Vertices settled by the last BuildRoute on the calling thread.
+    static size_t GetLastSettledCount();
+
+private:
+    using SearchState = graph::SearchState<Weight>;
+    static constexpr EdgeId NO_EDGE = SearchState::NO_EDGE;
+
+    struct QueryState {
+        SearchState forward;
+        SearchState backward;
+        std::vector<Weight> potentials;
+    };
+
+    static QueryState& GetQueryState() {
+        static thread_local QueryState state;
+        return state;
+    }
+
+    bool SearchForward(QueryState& state, VertexId from, VertexId to) const;
+    bool SearchGoalDirected(QueryState& state, VertexId from, VertexId to) const;
+    std::optional<VertexId> SearchBidirectional(QueryState& state, VertexId from, VertexId to) const;
+
+    static constexpr Weight ZERO_WEIGHT{};
+    const Graph& graph_;
+    SearchMode mode_;
+    LowerBound lower_bound_;
+    // BIDIRECTIONAL only
+    ReverseIncidence reverse_incidence_;
+};
+
+template <typename Weight>
+DijkstraRouter<Weight>::DijkstraRouter(const Graph& graph, SearchMode mode, LowerBound lower_bound)
+    : graph_(graph)
+    , mode_(mode)
+    , lower_bound_(std::move(lower_bound))
+{
+    if (mode_ == SearchMode::A_STAR && !lower_bound_) {
+        throw std::invalid_argument("A* search needs a lower bound");
+    }
+    CheckWeightsNonNegative(graph);
+    if (mode_ == SearchMode::BIDIRECTIONAL) {
+        reverse_incidence_ = ReverseIncidence(graph);
+    }
+}
+
+template <typename Weight>
+size_t DijkstraRouter<Weight>::GetLastSettledCount() {
+    const QueryState& state = GetQueryState();
+    return state.forward.GetSettledCount() + state.backward.GetSettledCount();
+}
+
+template <typename Weight>
+std::optional<typename DijkstraRouter<Weight>::RouteInfo> DijkstraRouter<Weight>::BuildRoute(VertexId from,
+                                                                                             VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    QueryState& state = GetQueryState();
+    state.forward.Prepare(vertex_count);
+    state.backward.Prepare(vertex_count);
+
+    VertexId meeting_vertex = to;
+    if (mode_ == SearchMode::BIDIRECTIONAL) {
+        const auto found_vertex = SearchBidirectional(state, from, to);
+        if (!found_vertex) {
+            return std::nullopt;
+        }
+        meeting_vertex = *found_vertex;
+    } else {
+        const bool found = mode_ == SearchMode::A_STAR ? SearchGoalDirected(state, from, to)
+                                                       : SearchForward(state, from, to);
+        if (!found) {
+            return std::nullopt;
+        }
+    }
+
+    std::vector<EdgeId> edges;
+    for (EdgeId edge_id = state.forward.GetPrevEdge(meeting_vertex); edge_id != NO_EDGE;
+         edge_id = state.forward.GetPrevEdge(graph_.GetEdge(edge_id).from))
+    {
+        edges.push_back(edge_id);
+    }
+    std::reverse(edges.begin(), edges.end());
+    Weight weight = state.forward.GetWeight(meeting_vertex);
+    if (meeting_vertex != to) {
+        for (EdgeId edge_id = state.backward.GetPrevEdge(meeting_vertex); edge_id != NO_EDGE;
+             edge_id = state.backward.GetPrevEdge(graph_.GetEdge(edge_id).to))
+        {
+            edges.push_back(edge_id);
+        }
+        weight = weight + state.backward.GetWeight(meeting_vertex);
+    }
+
+    return RouteInfo{weight, std::move(edges)};
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> DijkstraRouter<Weight>::BuildWeightMatrix(
+        const std::vector<VertexId>& sources, const std::vector<VertexId>& targets,
+        parallel::ThreadPool& thread_pool) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    std::vector<bool> is_target(vertex_count, false);
+    size_t distinct_target_count = 0;
+    for (const VertexId vertex : sources) {
+        if (vertex >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+    }
+    for (const VertexId vertex : targets) {
+        if (vertex >= vertex_count) {
+            throw std::out_of_range("Vertex id is out of range");
+        }
+        if (!is_target[vertex]) {
+            is_target[vertex] = true;
+            ++distinct_target_count;
+        }
+    }
+
+    std::vector<std::optional<Weight>> weights(sources.size() * targets.size());
+    thread_pool.ParallelFor(sources.size(), [&](size_t source_index) {
+        SearchState& search = GetQueryState().forward;
+        search.Prepare(vertex_count);
+        search.Relax(sources[source_index], ZERO_WEIGHT, NO_EDGE);
+
+        size_t targets_left = distinct_target_count;
+        typename SearchState::QueueItem item;
+        while (targets_left > 0 && search.PopSettled(item)) {
+            if (is_target[item.vertex]) {
+                --targets_left;
+            }
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                search.Relax(edge.to, item.weight + edge.weight, edge_id);
+            }
+        }
+
+        auto* row = weights.data() + source_index * targets.size();
+        for (size_t target_index = 0; target_index < targets.size(); ++target_index) {
+            if (search.IsReached(targets[target_index])) {
+                row[target_index] = search.GetWeight(targets[target_index]);
+            }
+        }
+    });
+    return weights;
+}
+
+template <typename Weight>
+bool DijkstraRouter<Weight>::SearchForward(QueryState& state, VertexId from, VertexId to) const {
+    SearchState& search = state.forward;
+    search.Relax(from, ZERO_WEIGHT, NO_EDGE);
+
+    typename SearchState::QueueItem item;
+    while (search.PopSettled(item)) {
+        if (item.vertex == to) {
+            return true;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            search.Relax(edge.to, item.weight + edge.weight, edge_id);
+        }
+    }
+    return false;
+}
+
+// A*: vertices are taken by weight plus the lower bound of the rest of the way, which is
+// computed once per vertex and query. With a consistent bound the target is settled optimally.
+template <typename Weight>
+bool DijkstraRouter<Weight>::SearchGoalDirected(QueryState& state, VertexId from, VertexId to) const {
+    SearchState& search = state.forward;
+    auto& potentials = state.potentials;
+    if (potentials.size() < graph_.GetVertexCount()) {
+        potentials.resize(graph_.GetVertexCount());
+    }
+    potentials[from] = lower_bound_(from, to);
+    search.Relax(from, ZERO_WEIGHT, NO_EDGE, potentials[from]);
+
+    typename SearchState::QueueItem item;
+    while (search.PopSettled(item)) {
+        if (item.vertex == to) {
+            return true;
+        }
+        for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+            const auto& edge = graph_.GetEdge(edge_id);
+            if (!search.IsReached(edge.to)) {
+                potentials[edge.to] = lower_bound_(edge.to, to);
+            }
+            search.Relax(edge.to, item.weight + edge.weight, edge_id, potentials[edge.to]);
+        }
+    }
+    return false;
+}
+
+// Alternates the forward and the backward search, always advancing the one with the smaller
+// queue top, and stops once the two tops together can no longer beat the best meeting found.
+template <typename Weight>
+std::optional<VertexId> DijkstraRouter<Weight>::SearchBidirectional(QueryState& state, VertexId from,
+                                                                    VertexId to) const {
+    SearchState& forward = state.forward;
+    SearchState& backward = state.backward;
+    forward.Relax(from, ZERO_WEIGHT, NO_EDGE);
+    backward.Relax(to, ZERO_WEIGHT, NO_EDGE);
+
+    std::optional<Weight> best_weight;
+    VertexId meeting_vertex = from;
+    if (from == to) {
+        return meeting_vertex;
+    }
+    const auto update_best = [&](VertexId vertex, Weight weight) {
+        if (!best_weight || weight < *best_weight) {
+            best_weight = weight;
+            meeting_vertex = vertex;
+        }
+    };
+
+    while (!forward.IsQueueEmpty() && !backward.IsQueueEmpty()) {
+        if (best_weight && !(forward.Top().key + backward.Top().key < *best_weight)) {
+            break;
+        }
+        typename SearchState::QueueItem item;
+        if (!(backward.Top().key < forward.Top().key)) {
+            if (!forward.PopSettled(item)) {
+                break;
+            }
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                forward.Relax(edge.to, item.weight + edge.weight, edge_id);
+                if (backward.IsReached(edge.to)) {
+                    update_best(edge.to, forward.GetWeight(edge.to) + backward.GetWeight(edge.to));
+                }
+            }
+        } else {
+            if (!backward.PopSettled(item)) {
+                break;
+            }
+            for (const EdgeId edge_id : reverse_incidence_.GetEnteringEdges(item.vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                backward.Relax(edge.from, item.weight + edge.weight, edge_id);
+                if (forward.IsReached(edge.from)) {
+                    update_best(edge.from, forward.GetWeight(edge.from) + backward.GetWeight(edge.from));
+                }
+            }
+        }
+    }
+    if (!best_weight) {
+        return std::nullopt;
+    }
+    return meeting_vertex;
+}
+
+template <typename Weight>
+struct ReachedVertex {
+    VertexId vertex;
+    Weight weight;
+    // the last edge of the route, SearchState<Weight>::NO_EDGE for `from` itself
+    EdgeId prev_edge;
+};
+
+// Every vertex within max_weight of `from`, with its route weight, in ascending order of weight,
+// so the start of every route comes before the vertex it leads to.
+// The search stops expanding as soon as the next vertex lies beyond the budget.
+template <typename Weight>
+std::vector<ReachedVertex<Weight>> FindVerticesWithin(const DirectedWeightedGraph<Weight>& graph,
+                                                      VertexId from, Weight max_weight) {
+    if (from >= graph.GetVertexCount()) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    static thread_local SearchState<Weight> search;
+    search.Prepare(graph.GetVertexCount());
+    search.Relax(from, Weight{}, SearchState<Weight>::NO_EDGE);
+
+    std::vector<ReachedVertex<Weight>> vertices;
+    typename SearchState<Weight>::QueueItem item;
+    while (search.PopSettled(item) && !(max_weight < item.weight)) {
+        vertices.push_back({item.vertex, item.weight, search.GetPrevEdge(item.vertex)});
+        for (const EdgeId edge_id : graph.GetIncidentEdges(item.vertex)) {
+            const auto& edge = graph.GetEdge(edge_id);
+            if (edge.weight < Weight{}) {
+                throw std::domain_error("Edges' weights should be non-negative");
+            }
+            search.Relax(edge.to, item.weight + edge.weight, edge_id);
+        }
+    }
+    return vertices;
+}
+
+}  // namespace graph
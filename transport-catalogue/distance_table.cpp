@@ -0,0 +1,69 @@
+#include "distance_table.h"
+
+#include <utility>
+
+namespace tc::catalogue {
+
+void DistanceTable::Set(StopId from, StopId to, double distance) {
+    if (entries_.empty()) {
+        Grow();
+    }
+    const uint64_t key = PackKey(from, to);
+    size_t slot = FindSlot(key);
+    if (entries_[slot].key != EMPTY_KEY) {
+        return;
+    }
+    // only a new key takes a slot, so only it may need a larger table
+    if ((size_ + 1) * 4 > entries_.size() * 3) {
+        Grow();
+        slot = FindSlot(key);
+    }
+    entries_[slot] = {key, distance};
+    ++size_;
+}
+
+std::optional<double> DistanceTable::Get(StopId from, StopId to) const {
+    if (entries_.empty()) {
+        return std::nullopt;
+    }
+    if (const auto& entry = entries_[FindSlot(PackKey(from, to))]; entry.key != EMPTY_KEY) {
+        return entry.distance;
+    }
+    if (const auto& entry = entries_[FindSlot(PackKey(to, from))]; entry.key != EMPTY_KEY) {
+        return entry.distance;
+    }
+    return std::nullopt;
+}
+
+uint64_t DistanceTable::PackKey(StopId from, StopId to) {
+    return (uint64_t{from} << 32) | to;
+}
+
+size_t DistanceTable::FindSlot(uint64_t key) const {
+    // the finalizer of MurmurHash3: every bit of both ids affects the low bits used as the slot
+    uint64_t hash = key;
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+
+    const size_t mask = entries_.size() - 1;
+    size_t slot = hash & mask;
+    while (entries_[slot].key != key && entries_[slot].key != EMPTY_KEY) {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+void DistanceTable::Grow() {
+    std::vector<Entry> entries(entries_.empty() ? 16 : entries_.size() * 2, Entry{EMPTY_KEY, 0});
+    std::swap(entries_, entries);
+    for (const auto& entry : entries) {
+        if (entry.key != EMPTY_KEY) {
+            entries_[FindSlot(entry.key)] = entry;
+        }
+    }
+}
+
+}
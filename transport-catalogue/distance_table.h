@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "domain.h"
+
+namespace tc::catalogue {
+
+// Road distances between stops in one flat array with open addressing and linear probing.
+// A key packs the ids of both stops into 64 bits, so a lookup hashes a single integer and
+// scans adjacent slots instead of chasing list nodes, and an entry takes 16 bytes.
+class DistanceTable {
+public:
+    using StopId = domain::StopId;
+
+    // Keeps the distance set first if the pair is set again.
+    void Set(StopId from, StopId to, double distance);
+
+    // The distance from `from` to `to` or, if only the opposite direction is known, that one.
+    std::optional<double> Get(StopId from, StopId to) const;
+
+private:
+    struct Entry {
+        uint64_t key;
+        double distance;
+    };
+    // no stop has the largest id, so no pair packs to this
+    static constexpr uint64_t EMPTY_KEY = ~uint64_t{0};
+
+    static uint64_t PackKey(StopId from, StopId to);
+    // the slot of the key or, if it is absent, the empty slot where it would go
+    size_t FindSlot(uint64_t key) const;
+    void Grow();
+
+    // the size is a power of two, and at most 3/4 of the slots are taken
+    std::vector<Entry> entries_;
+    size_t size_ = 0;
+};
+
+}
@@ -1,27 +1,14 @@
 #pragma once
 
-#include <string>
-#include <unordered_set>
-#include <vector>
-
-#include "geo.h"
+#include <cstdint>
+#include <functional>
+#include <utility>
 
 namespace tc::domain {
 
-struct Bus;
-
-struct Stop {
-public:
-    std::string name;
-    geo::Coordinates coordinates;
-    std::unordered_set<const Bus *> buses;
-};
-
-struct Bus {
-    std::string name;
-    std::vector<const Stop *> stops;
-    bool is_roundtrip;
-};
+// Dense ids of the stops and buses of a catalogue, in the order they were added.
+using StopId = uint32_t;
+using BusId = uint32_t;
 
 template<typename T>
 void
@@ -2,7 +2,11 @@
 
 #include "ranges.h"
 
+#include <cstddef>
 #include <cstdlib>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
 namespace graph {
@@ -17,17 +21,73 @@ struct Edge {
     Weight weight;
 };
 
+// Walks the ids of a vertex's outgoing edges. While the graph is being built they come
+// from the vertex's incidence list; once it is frozen they form a contiguous id range.
+class IncidentEdgeIterator {
+public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = EdgeId;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const EdgeId*;
+    using reference = EdgeId;
+
+    explicit IncidentEdgeIterator(const EdgeId* list_it)
+        : list_it_(list_it) {
+    }
+    explicit IncidentEdgeIterator(EdgeId edge_id)
+        : edge_id_(edge_id) {
+    }
+
+    EdgeId operator*() const {
+        return list_it_ ? *list_it_ : edge_id_;
+    }
+    IncidentEdgeIterator& operator++() {
+        if (list_it_) {
+            ++list_it_;
+        } else {
+            ++edge_id_;
+        }
+        return *this;
+    }
+    IncidentEdgeIterator operator++(int) {
+        auto prev = *this;
+        ++*this;
+        return prev;
+    }
+    bool operator==(const IncidentEdgeIterator& other) const {
+        return list_it_ == other.list_it_ && edge_id_ == other.edge_id_;
+    }
+    bool operator!=(const IncidentEdgeIterator& other) const {
+        return !(*this == other);
+    }
+
+private:
+    const EdgeId* list_it_ = nullptr;
+    EdgeId edge_id_ = 0;
+};
+
+// Edges are appended with AddEdge and then, optionally, compacted by Freeze into
+// compressed sparse row form: edges_ is reordered by source vertex and offsets_[v]
+// is the id of the first edge leaving v, so relaxing a vertex scans edges_ sequentially.
 template <typename Weight>
 class DirectedWeightedGraph {
 private:
     using IncidenceList = std::vector<EdgeId>;
-    using IncidentEdgesRange = ranges::Range<typename IncidenceList::const_iterator>;
+    using IncidentEdgesRange = ranges::Range<IncidentEdgeIterator>;
 
 public:
     DirectedWeightedGraph() = default;
     explicit DirectedWeightedGraph(size_t vertex_count);
+    // A frozen graph over edges sorted by source, e.g. the edges of another frozen graph
+    // in id order; edge ids are kept.
+    DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges);
     EdgeId AddEdge(const Edge<Weight>& edge);
 
+    // Switches the graph to CSR layout. Edge ids change; the returned vector maps
+    // every old edge id to its new one. Adding edges afterwards is not allowed.
+    std::vector<EdgeId> Freeze();
+    bool IsFrozen() const;
+
     size_t GetVertexCount() const;
     size_t GetEdgeCount() const;
     const Edge<Weight>& GetEdge(EdgeId edge_id) const;
@@ -36,6 +96,7 @@ public:
 private:
     std::vector<Edge<Weight>> edges_;
     std::vector<IncidenceList> incidence_lists_;
+    std::vector<EdgeId> offsets_;
 };
 
 template <typename Weight>
@@ -43,17 +104,73 @@ DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count)
     : incidence_lists_(vertex_count) {
 }
 
+template <typename Weight>
+DirectedWeightedGraph<Weight>::DirectedWeightedGraph(size_t vertex_count, std::vector<Edge<Weight>> edges)
+    : edges_(std::move(edges))
+    , offsets_(vertex_count + 1, 0) {
+    for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+        const auto& edge = edges_[edge_id];
+        if (edge.from >= vertex_count || edge.to >= vertex_count
+            || (edge_id > 0 && edge.from < edges_[edge_id - 1].from)) {
+            throw std::invalid_argument("Edges should be sorted by source and stay within the graph");
+        }
+        ++offsets_[edge.from + 1];
+    }
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        offsets_[vertex + 1] += offsets_[vertex];
+    }
+}
+
 template <typename Weight>
 EdgeId DirectedWeightedGraph<Weight>::AddEdge(const Edge<Weight>& edge) {
+    if (IsFrozen()) {
+        throw std::logic_error("Cannot add an edge to a frozen graph");
+    }
     edges_.push_back(edge);
     const EdgeId id = edges_.size() - 1;
     incidence_lists_.at(edge.from).push_back(id);
     return id;
 }
 
+template <typename Weight>
+std::vector<EdgeId> DirectedWeightedGraph<Weight>::Freeze() {
+    if (IsFrozen()) {
+        std::vector<EdgeId> new_ids(edges_.size());
+        for (EdgeId edge_id = 0; edge_id < edges_.size(); ++edge_id) {
+            new_ids[edge_id] = edge_id;
+        }
+        return new_ids;
+    }
+
+    const size_t vertex_count = incidence_lists_.size();
+    offsets_.assign(vertex_count + 1, 0);
+    for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+        offsets_[vertex + 1] = offsets_[vertex] + incidence_lists_[vertex].size();
+    }
+
+    std::vector<EdgeId> new_ids(edges_.size());
+    std::vector<Edge<Weight>> edges;
+    edges.reserve(edges_.size());
+    for (const auto& incidence_list : incidence_lists_) {
+        for (const EdgeId edge_id : incidence_list) {
+            new_ids[edge_id] = edges.size();
+            edges.push_back(edges_[edge_id]);
+        }
+    }
+    edges_ = std::move(edges);
+    incidence_lists_.clear();
+    incidence_lists_.shrink_to_fit();
+    return new_ids;
+}
+
+template <typename Weight>
+bool DirectedWeightedGraph<Weight>::IsFrozen() const {
+    return !offsets_.empty();
+}
+
 template <typename Weight>
 size_t DirectedWeightedGraph<Weight>::GetVertexCount() const {
-    return incidence_lists_.size();
+    return IsFrozen() ? offsets_.size() - 1 : incidence_lists_.size();
 }
 
 template <typename Weight>
@@ -69,6 +186,57 @@ const Edge<Weight>& DirectedWeightedGraph<Weight>::GetEdge(EdgeId edge_id) const
 template <typename Weight>
 typename DirectedWeightedGraph<Weight>::IncidentEdgesRange
 DirectedWeightedGraph<Weight>::GetIncidentEdges(VertexId vertex) const {
-    return ranges::AsRange(incidence_lists_.at(vertex));
+    if (IsFrozen()) {
+        return {IncidentEdgeIterator(offsets_.at(vertex)), IncidentEdgeIterator(offsets_.at(vertex + 1))};
+    }
+    const auto& incidence_list = incidence_lists_.at(vertex);
+    return {IncidentEdgeIterator(incidence_list.data()),
+            IncidentEdgeIterator(incidence_list.data() + incidence_list.size())};
+}
+
+// Throws std::domain_error if an edge of the graph has a negative weight.
+template <typename Weight>
+void CheckWeightsNonNegative(const DirectedWeightedGraph<Weight>& graph) {
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        if (graph.GetEdge(edge_id).weight < Weight{}) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+    }
+}
+
+// The ids of the edges entering each vertex of a graph, in compressed sparse row form, for
+// the searches that run against the edges. The graph must not get new edges afterwards.
+class ReverseIncidence {
+public:
+    using EdgesRange = ranges::Range<const EdgeId*>;
+
+    ReverseIncidence() = default;
+    template <typename Weight>
+    explicit ReverseIncidence(const DirectedWeightedGraph<Weight>& graph);
+
+    EdgesRange GetEnteringEdges(VertexId vertex) const {
+        return {edges_.data() + offsets_.at(vertex), edges_.data() + offsets_.at(vertex + 1)};
+    }
+
+private:
+    // the edges entering v are edges_[offsets_[v]] .. edges_[offsets_[v + 1] - 1], by id
+    std::vector<size_t> offsets_;
+    std::vector<EdgeId> edges_;
+};
+
+template <typename Weight>
+ReverseIncidence::ReverseIncidence(const DirectedWeightedGraph<Weight>& graph)
+    : offsets_(graph.GetVertexCount() + 1, 0)
+    , edges_(graph.GetEdgeCount()) {
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        ++offsets_[graph.GetEdge(edge_id).to + 1];
+    }
+    for (VertexId vertex = 0; vertex < graph.GetVertexCount(); ++vertex) {
+        offsets_[vertex + 1] += offsets_[vertex];
+    }
+    std::vector<size_t> positions(offsets_.begin(), offsets_.end() - 1);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        edges_[positions[graph.GetEdge(edge_id).to]++] = edge_id;
+    }
 }
 }  // namespace graph
\ No newline at end of file
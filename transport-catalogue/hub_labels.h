@@ -0,0 +1,330 @@
+#pragma once
+
+#include "graph.h"
+#include "router.h"
+#include "search_state.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Hub labels built by pruned landmark labeling. Every vertex keeps a forward label, hubs it
+// reaches with their weights, and a backward label, hubs that reach it; for any two vertices
+// some shortest route passes a hub both labels share, so a query merges two short sorted arrays.
+// Vertices are taken as hubs in order of degree, and a pruned Dijkstra from each one only labels
+// the vertices that the hubs taken before it do not already cover.
+template <typename Weight>
+class HubLabels {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    using RouteInfo = typename Router<Weight>::RouteInfo;
+
+    // The edge leads towards the hub: the first edge of the route to it in a forward label,
+    // the last edge of the route from it in a backward one; NO_EDGE for the hub itself.
+    struct LabelEntry {
+        size_t hub_rank;
+        Weight weight;
+        EdgeId edge;
+    };
+
+    // Everything preprocessing computes; enough to answer queries over the same graph.
+    // Labels are stored in CSR form and sorted by hub rank.
+    struct Index {
+        std::vector<VertexId> hubs;  // by rank
+        std::vector<size_t> forward_offsets;
+        std::vector<LabelEntry> forward_entries;
+        std::vector<size_t> backward_offsets;
+        std::vector<LabelEntry> backward_entries;
+    };
+
+    explicit HubLabels(const Graph& graph);
+    // Skips preprocessing and answers queries with an index taken from GetIndex.
+    HubLabels(const Graph& graph, Index index);
+
+    const Index& GetIndex() const;
+
+    std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
+
+    // Route weights from every source to every target, row by row; nullopt for unreachable targets.
+    std::vector<std::optional<Weight>> BuildWeightMatrix(
+            const std::vector<VertexId>& sources, const std::vector<VertexId>& targets,
+            parallel::ThreadPool& thread_pool = parallel::DefaultThreadPool()) const;
+
+private:
+    using Label = ranges::Range<const LabelEntry*>;
+    static constexpr EdgeId NO_EDGE = SearchState<Weight>::NO_EDGE;
+    static constexpr Weight ZERO_WEIGHT{};
+
+    Label GetForwardLabel(VertexId vertex) const;
+    Label GetBackwardLabel(VertexId vertex) const;
+    static const LabelEntry& FindEntry(Label label, size_t hub_rank);
+
+    // The shared hub with the lightest route through it, as an index pair into the labels.
+    std::optional<std::pair<const LabelEntry*, const LabelEntry*>> FindBestHub(VertexId from, VertexId to) const;
+
+    // A pruned Dijkstra from the hub of the given rank over the edges (their reverse, if backward)
+    // that adds the hub to the backward (forward) labels of the vertices it does not cover yet.
+    void AddHub(size_t hub_rank, bool backward, const ReverseIncidence& reverse_incidence,
+                std::vector<std::vector<LabelEntry>>& forward_labels,
+                std::vector<std::vector<LabelEntry>>& backward_labels, std::vector<Weight>& hub_weights) const;
+
+    static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::has_infinity
+                                          ? std::numeric_limits<Weight>::infinity()
+                                          : std::numeric_limits<Weight>::max();
+
+    const Graph& graph_;
+    Index index_;
+};
+
+template <typename Weight>
+HubLabels<Weight>::HubLabels(const Graph& graph)
+    : graph_(graph)
+{
+    const size_t vertex_count = graph.GetVertexCount();
+    CheckWeightsNonNegative(graph);
+    const ReverseIncidence reverse_incidence(graph);
+    std::vector<size_t> degrees(vertex_count, 0);
+    for (EdgeId edge_id = 0; edge_id < graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph.GetEdge(edge_id);
+        ++degrees[edge.from];
+        ++degrees[edge.to];
+    }
+
+    index_.hubs.resize(vertex_count);
+    std::iota(index_.hubs.begin(), index_.hubs.end(), 0);
+    std::stable_sort(index_.hubs.begin(), index_.hubs.end(), [&degrees](VertexId lhs, VertexId rhs) {
+        return degrees[lhs] > degrees[rhs];
+    });
+
+    // hubs are added in rank order, so every label stays sorted by rank
+    std::vector<std::vector<LabelEntry>> forward_labels(vertex_count);
+    std::vector<std::vector<LabelEntry>> backward_labels(vertex_count);
+    std::vector<Weight> hub_weights(vertex_count, UNREACHABLE);
+    for (size_t hub_rank = 0; hub_rank < vertex_count; ++hub_rank) {
+        AddHub(hub_rank, false, reverse_incidence, forward_labels, backward_labels, hub_weights);
+        AddHub(hub_rank, true, reverse_incidence, forward_labels, backward_labels, hub_weights);
+    }
+
+    const auto flatten = [vertex_count](std::vector<std::vector<LabelEntry>>& labels, std::vector<size_t>& offsets,
+                                        std::vector<LabelEntry>& entries) {
+        offsets.assign(vertex_count + 1, 0);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            offsets[vertex + 1] = offsets[vertex] + labels[vertex].size();
+        }
+        entries.reserve(offsets.back());
+        for (auto& label : labels) {
+            entries.insert(entries.end(), label.begin(), label.end());
+            label = {};
+        }
+    };
+    flatten(forward_labels, index_.forward_offsets, index_.forward_entries);
+    flatten(backward_labels, index_.backward_offsets, index_.backward_entries);
+}
+
+template <typename Weight>
+HubLabels<Weight>::HubLabels(const Graph& graph, Index index)
+    : graph_(graph)
+    , index_(std::move(index))
+{
+    const size_t vertex_count = graph.GetVertexCount();
+    const auto labels_fit = [this, &graph, vertex_count](const std::vector<size_t>& offsets,
+                                                         const std::vector<LabelEntry>& entries) {
+        if (offsets.size() != vertex_count + 1 || offsets.front() != 0 || offsets.back() != entries.size()
+            || !std::is_sorted(offsets.begin(), offsets.end())) {
+            return false;
+        }
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            for (size_t i = offsets[vertex]; i < offsets[vertex + 1]; ++i) {
+                const auto& entry = entries[i];
+                if (entry.hub_rank >= vertex_count || (i > offsets[vertex] && entries[i - 1].hub_rank >= entry.hub_rank)
+                    || (entry.edge != NO_EDGE && entry.edge >= graph.GetEdgeCount())
+                    || (entry.edge == NO_EDGE && index_.hubs[entry.hub_rank] != vertex)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    };
+    const bool hubs_fit = index_.hubs.size() == vertex_count
+                          && std::all_of(index_.hubs.begin(), index_.hubs.end(), [vertex_count](VertexId hub) {
+                                 return hub < vertex_count;
+                             });
+    if (!hubs_fit || !labels_fit(index_.forward_offsets, index_.forward_entries)
+        || !labels_fit(index_.backward_offsets, index_.backward_entries)) {
+        throw std::invalid_argument("Hub label index does not match the graph");
+    }
+}
+
+template <typename Weight>
+const typename HubLabels<Weight>::Index& HubLabels<Weight>::GetIndex() const {
+    return index_;
+}
+
+template <typename Weight>
+std::optional<typename HubLabels<Weight>::RouteInfo> HubLabels<Weight>::BuildRoute(VertexId from,
+                                                                                   VertexId to) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    if (from >= vertex_count || to >= vertex_count) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    if (from == to) {
+        return RouteInfo{ZERO_WEIGHT, {}};
+    }
+    const auto best_hub = FindBestHub(from, to);
+    if (!best_hub) {
+        return std::nullopt;
+    }
+    const auto [forward_entry, backward_entry] = *best_hub;
+    const size_t hub_rank = forward_entry->hub_rank;
+
+    // entries on the way keep pointing towards the hub: a vertex is only expanded
+    // by the search from the hub after it has been labelled with it
+    RouteInfo route{forward_entry->weight + backward_entry->weight, {}};
+    for (const LabelEntry* entry = forward_entry; entry->edge != NO_EDGE;) {
+        route.edges.push_back(entry->edge);
+        entry = &FindEntry(GetForwardLabel(graph_.GetEdge(entry->edge).to), hub_rank);
+    }
+    const size_t forward_edge_count = route.edges.size();
+    for (const LabelEntry* entry = backward_entry; entry->edge != NO_EDGE;) {
+        route.edges.push_back(entry->edge);
+        entry = &FindEntry(GetBackwardLabel(graph_.GetEdge(entry->edge).from), hub_rank);
+    }
+    std::reverse(route.edges.begin() + forward_edge_count, route.edges.end());
+    return route;
+}
+
+template <typename Weight>
+std::vector<std::optional<Weight>> HubLabels<Weight>::BuildWeightMatrix(const std::vector<VertexId>& sources,
+                                                                        const std::vector<VertexId>& targets,
+                                                                        parallel::ThreadPool& thread_pool) const {
+    const size_t vertex_count = graph_.GetVertexCount();
+    const auto out_of_range = [vertex_count](VertexId vertex) {
+        return vertex >= vertex_count;
+    };
+    if (std::any_of(sources.begin(), sources.end(), out_of_range)
+        || std::any_of(targets.begin(), targets.end(), out_of_range)) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+
+    std::vector<std::optional<Weight>> weights(sources.size() * targets.size());
+    thread_pool.ParallelFor(sources.size(), [&](size_t source_index) {
+        for (size_t target_index = 0; target_index < targets.size(); ++target_index) {
+            auto& weight = weights[source_index * targets.size() + target_index];
+            if (sources[source_index] == targets[target_index]) {
+                weight = ZERO_WEIGHT;
+            } else if (const auto best_hub = FindBestHub(sources[source_index], targets[target_index])) {
+                weight = best_hub->first->weight + best_hub->second->weight;
+            }
+        }
+    });
+    return weights;
+}
+
+template <typename Weight>
+typename HubLabels<Weight>::Label HubLabels<Weight>::GetForwardLabel(VertexId vertex) const {
+    const LabelEntry* entries = index_.forward_entries.data();
+    return {entries + index_.forward_offsets[vertex], entries + index_.forward_offsets[vertex + 1]};
+}
+
+template <typename Weight>
+typename HubLabels<Weight>::Label HubLabels<Weight>::GetBackwardLabel(VertexId vertex) const {
+    const LabelEntry* entries = index_.backward_entries.data();
+    return {entries + index_.backward_offsets[vertex], entries + index_.backward_offsets[vertex + 1]};
+}
+
+template <typename Weight>
+const typename HubLabels<Weight>::LabelEntry& HubLabels<Weight>::FindEntry(Label label, size_t hub_rank) {
+    const auto it = std::lower_bound(label.begin(), label.end(), hub_rank,
+                                     [](const LabelEntry& entry, size_t rank) {
+                                         return entry.hub_rank < rank;
+                                     });
+    if (it == label.end() || it->hub_rank != hub_rank) {
+        throw std::logic_error("Hub labels are inconsistent");
+    }
+    return *it;
+}
+
+template <typename Weight>
+std::optional<std::pair<const typename HubLabels<Weight>::LabelEntry*, const typename HubLabels<Weight>::LabelEntry*>>
+HubLabels<Weight>::FindBestHub(VertexId from, VertexId to) const {
+    const Label forward_label = GetForwardLabel(from);
+    const Label backward_label = GetBackwardLabel(to);
+    std::optional<std::pair<const LabelEntry*, const LabelEntry*>> best_hub;
+    Weight best_weight{};
+    const LabelEntry* forward_it = forward_label.begin();
+    const LabelEntry* backward_it = backward_label.begin();
+    while (forward_it != forward_label.end() && backward_it != backward_label.end()) {
+        if (forward_it->hub_rank < backward_it->hub_rank) {
+            ++forward_it;
+        } else if (backward_it->hub_rank < forward_it->hub_rank) {
+            ++backward_it;
+        } else {
+            const Weight weight = forward_it->weight + backward_it->weight;
+            if (!best_hub || weight < best_weight) {
+                best_hub.emplace(forward_it, backward_it);
+                best_weight = weight;
+            }
+            ++forward_it;
+            ++backward_it;
+        }
+    }
+    return best_hub;
+}
+
+template <typename Weight>
+void HubLabels<Weight>::AddHub(size_t hub_rank, bool backward, const ReverseIncidence& reverse_incidence,
+                               std::vector<std::vector<LabelEntry>>& forward_labels,
+                               std::vector<std::vector<LabelEntry>>& backward_labels,
+                               std::vector<Weight>& hub_weights) const {
+    const VertexId hub = index_.hubs[hub_rank];
+    // the hub's own label on the side the search starts from, spread by rank for the pruning test
+    auto& hub_label = backward ? backward_labels[hub] : forward_labels[hub];
+    auto& reached_labels = backward ? forward_labels : backward_labels;
+    for (const auto& entry : hub_label) {
+        hub_weights[entry.hub_rank] = entry.weight;
+    }
+
+    static thread_local SearchState<Weight> search;
+    search.Prepare(graph_.GetVertexCount());
+    search.Relax(hub, ZERO_WEIGHT, NO_EDGE);
+    typename SearchState<Weight>::QueueItem item;
+    while (search.PopSettled(item)) {
+        // a route through an earlier hub is as short: the vertex and all it leads to are covered
+        const auto& label = reached_labels[item.vertex];
+        const bool covered = std::any_of(label.begin(), label.end(), [&](const LabelEntry& entry) {
+            return hub_weights[entry.hub_rank] != UNREACHABLE
+                   && !(item.weight < hub_weights[entry.hub_rank] + entry.weight);
+        });
+        if (covered) {
+            continue;
+        }
+        reached_labels[item.vertex].push_back({hub_rank, item.weight, search.GetPrevEdge(item.vertex)});
+
+        if (backward) {
+            for (const EdgeId edge_id : reverse_incidence.GetEnteringEdges(item.vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                search.Relax(edge.from, item.weight + edge.weight, edge_id);
+            }
+        } else {
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                search.Relax(edge.to, item.weight + edge.weight, edge_id);
+            }
+        }
+    }
+
+    for (const auto& entry : hub_label) {
+        hub_weights[entry.hub_rank] = UNREACHABLE;
+    }
+}
+
+}  // namespace graph
@@ -1,7 +1,10 @@
 #include "json_reader.h"
 #include "json_builder.h"
 
+#include <cmath>
+#include <limits>
 #include <sstream>
+#include <stdexcept>
 #include <unordered_map>
 
 namespace tc::io {
@@ -82,6 +85,47 @@ public:
     ~StopOutputFormer() override = default;
 };
 
+class NearestStopsOutputFormer : public OutputFormer
+{
+public:
+    void Form(json::Builder& response, const json::Dict& request, const RequestHandler& handler) const override
+    {
+        const Coordinates coordinates{request.at("latitude").AsDouble(), request.at("longitude").AsDouble()};
+        const int count = request.at("count").AsInt();
+        if(count < 0) {
+            response.Key("error_message").Value("count should not be negative"s);
+            return;
+        }
+        auto stops = response.Key("stops").StartArray();
+        for(const auto& nearby_stop: handler.FindNearestStops(coordinates, static_cast<size_t>(count))) {
+            stops.StartDict()
+                    .Key("stop_name").Value(std::string(nearby_stop.stop.name))
+                    .Key("distance").Value(nearby_stop.distance)
+                    .EndDict();
+        }
+        stops.EndArray();
+    }
+
+    ~NearestStopsOutputFormer() override = default;
+};
+
+class StopsInBoxOutputFormer : public OutputFormer
+{
+public:
+    void Form(json::Builder& response, const json::Dict& request, const RequestHandler& handler) const override
+    {
+        const Coordinates min{request.at("min_latitude").AsDouble(), request.at("min_longitude").AsDouble()};
+        const Coordinates max{request.at("max_latitude").AsDouble(), request.at("max_longitude").AsDouble()};
+        auto stops = response.Key("stops").StartArray();
+        for(const auto& stop: handler.GetStopsInBox(min, max)) {
+            stops.Value(std::string(stop.name));
+        }
+        stops.EndArray();
+    }
+
+    ~StopsInBoxOutputFormer() override = default;
+};
+
 class RouteOutputFormer : public OutputFormer
 {
 private:
@@ -100,26 +144,94 @@ private:
             response.StartDict()
                     .Key("type").Value("Wait"s)
                     .Key("time").Value(item.time)
-                    .Key("stop_name").Value(std::string(item.stop_name.data()))
+                    .Key("stop_name").Value(std::string(item.stop_name))
                     .EndDict();
         }
     };
 
+    // a stop name or a dict with the latitude and the longitude of a point
+    static RequestHandler::RoutePoint ReadRoutePoint(const json::Node& point_node) {
+        if(point_node.IsString()) {
+            return std::string_view(point_node.AsString());
+        }
+        const auto& point = point_node.AsMap();
+        return Coordinates{point.at("latitude").AsDouble(), point.at("longitude").AsDouble()};
+    }
+
+    static void FormRoute(json::Builder& response, const routing::TransportRouter::Route& route) {
+        response.Key("total_time").Value(route.total_time);
+        auto items = response.Key("items").StartArray();
+        for(const auto& item: route.items) {
+            std::visit(RouteItemVisitor{response}, item);
+        }
+        items.EndArray();
+    }
+
+    static void FormRouteEnd(json::Builder& response, const std::string& key,
+                             const routing::TransportRouter::RouteEnd& route_end) {
+        response.Key(key).StartDict()
+                .Key("stop_name").Value(std::string(route_end.stop_name))
+                .Key("walk_time").Value(route_end.walk_time)
+                .EndDict();
+    }
+
 public:
     void Form(json::Builder& response, const json::Dict& request, const RequestHandler& handler) const override
     {
-        const auto& from = request.at("from").AsString();
-        const auto& to = request.at("to").AsString();
-        auto route = handler.GetRoute(from, to);
+        const auto& from = request.at("from");
+        const auto& to = request.at("to");
+        // the same units as in routing_settings
+        routing::TransportRouter::RouteOverrides overrides;
+        if(request.count("bus_wait_time")) {
+            overrides.bus_wait_time = request.at("bus_wait_time").AsInt();
+            if(*overrides.bus_wait_time < 0) {
+                response.Key("error_message").Value("bus_wait_time should not be negative"s);
+                return;
+            }
+        }
+        if(request.count("bus_velocity")) {
+            overrides.bus_velocity = request.at("bus_velocity").AsDouble() * 1000.0 / 60.0;
+            if(!(*overrides.bus_velocity > 0)) {
+                response.Key("error_message").Value("bus_velocity should be positive"s);
+                return;
+            }
+        }
+
+        if(from.IsString() && to.IsString()) {
+            auto route = handler.GetRoute(from.AsString(), to.AsString(), overrides);
+            if(!route) {
+                response.Key("error_message").Value("not found"s);
+            } else {
+                FormRoute(response, *route);
+            }
+            return;
+        }
+
+        // an end given as a point is walked from or to: the stops it is snapped to and the walk
+        // to the chosen one are reported
+        RequestHandler::WalkSettings walk_settings;
+        if(request.count("walk_velocity")) {
+            walk_settings.velocity = request.at("walk_velocity").AsDouble() * 1000.0 / 60.0;
+            if(!(walk_settings.velocity > 0)) {
+                response.Key("error_message").Value("walk_velocity should be positive"s);
+                return;
+            }
+        }
+        if(request.count("walk_stop_count")) {
+            const int stop_count = request.at("walk_stop_count").AsInt();
+            if(stop_count < 0) {
+                response.Key("error_message").Value("walk_stop_count should not be negative"s);
+                return;
+            }
+            walk_settings.stop_count = static_cast<size_t>(stop_count);
+        }
+        auto route = handler.GetRoute(ReadRoutePoint(from), ReadRoutePoint(to), walk_settings, overrides);
         if(!route) {
             response.Key("error_message").Value("not found"s);
         } else {
-            response.Key("total_time").Value(route->total_time);
-            auto items = response.Key("items").StartArray();
-            for(const auto& item: route->items) {
-                std::visit(RouteItemVisitor{response}, item);
-            }
-            items.EndArray();
+            FormRoute(response, route->route);
+            FormRouteEnd(response, "from_stop"s, route->from);
+            FormRouteEnd(response, "to_stop"s, route->to);
         }
     }
 
@@ -128,6 +240,62 @@ public:
 
 };
 
+class RouteMatrixOutputFormer : public OutputFormer
+{
+public:
+    void Form(json::Builder& response, const json::Dict& request, const RequestHandler& handler) const override
+    {
+        const auto read_stops = [](const json::Node& stops_node) {
+            std::vector<std::string_view> stops;
+            for(const auto& stop: stops_node.AsArray()) {
+                stops.emplace_back(stop.AsString());
+            }
+            return stops;
+        };
+        const auto travel_times = handler.GetTravelTimes(read_stops(request.at("from")), read_stops(request.at("to")));
+
+        auto rows = response.Key("total_times").StartArray();
+        for(const auto& row: travel_times) {
+            auto cells = rows.StartArray();
+            for(const auto& travel_time: row) {
+                if(travel_time) {
+                    cells.Value(*travel_time);
+                } else {
+                    cells.Value(nullptr);
+                }
+            }
+            cells.EndArray();
+        }
+        rows.EndArray();
+    }
+
+    ~RouteMatrixOutputFormer() override = default;
+};
+
+class IsochroneOutputFormer : public OutputFormer
+{
+public:
+    void Form(json::Builder& response, const json::Dict& request, const RequestHandler& handler) const override
+    {
+        const auto& from = request.at("from").AsString();
+        const auto reachable_stops = handler.GetReachableStops(from, request.at("max_time").AsDouble());
+        if(!reachable_stops) {
+            response.Key("error_message").Value("not found"s);
+        } else {
+            auto stops = response.Key("stops").StartArray();
+            for(const auto& reachable_stop: *reachable_stops) {
+                stops.StartDict()
+                        .Key("stop_name").Value(std::string(reachable_stop.stop_name))
+                        .Key("time").Value(reachable_stop.time)
+                        .EndDict();
+            }
+            stops.EndArray();
+        }
+    }
+
+    ~IsochroneOutputFormer() override = default;
+};
+
 class MapOutputFormer : public OutputFormer
 {
 public:
@@ -151,12 +319,14 @@ void JsonReader::ApplyCommands(catalogue::TransportCatalogue& db,
                                routing::TransportRouter& router) const {
     auto& requests_map = requests_.GetRoot().AsMap();
     FillCatalogue(db, requests_map.at("base_requests").AsArray());
+    db.Freeze();
     SettingRenderer(renderer, requests_map.at("render_settings").AsMap());
     SettingRouter(router, requests_map.at("routing_settings").AsMap());
     router.SetData(db.GetBuses().begin(), db.GetBuses().end(),
                    db.GetStops().begin(), db.GetStops().end(),
-                   [&db](std::string_view stop1, std::string_view stop2) {
-                       return db.GetDistance(stop1, stop2);
+                   [&db](const catalogue::TransportCatalogue::Stop& stop1,
+                         const catalogue::TransportCatalogue::Stop& stop2) {
+                       return db.GetDistance(stop1.id, stop2.id);
     });
 }
 
@@ -269,6 +439,66 @@ void JsonReader::SettingRouter(routing::TransportRouter& router, const json::Dic
     if (requests.count("bus_velocity")) {
         settings.bus_velocity = requests.at("bus_velocity").AsDouble() * 1000.0 / 60.0;
     }
+    if (requests.count("index_file")) {
+        settings.index_file = requests.at("index_file").AsString();
+    }
+    if (requests.count("backend")) {
+        static const std::unordered_map<std::string_view, routing::RouterBackend> backends = {
+                {"all_pairs", routing::RouterBackend::ALL_PAIRS},
+                {"dijkstra", routing::RouterBackend::DIJKSTRA},
+                {"bidirectional_dijkstra", routing::RouterBackend::BIDIRECTIONAL_DIJKSTRA},
+                {"a_star", routing::RouterBackend::A_STAR},
+                {"ch", routing::RouterBackend::CONTRACTION_HIERARCHIES},
+                {"alt", routing::RouterBackend::ALT},
+                {"hub_labels", routing::RouterBackend::HUB_LABELS},
+                {"auto", routing::RouterBackend::AUTO}};
+        const auto& backend = requests.at("backend").AsString();
+        const auto backend_it = backends.find(backend);
+        if (backend_it == backends.end()) {
+            throw std::invalid_argument("Unknown routing backend: " + backend);
+        }
+        settings.backend = backend_it->second;
+    }
+    if (requests.count("graph_model")) {
+        static const std::unordered_map<std::string_view, routing::GraphModel> graph_models = {
+                {"stop_pairs", routing::GraphModel::STOP_PAIRS},
+                {"rides", routing::GraphModel::RIDES}};
+        const auto& graph_model = requests.at("graph_model").AsString();
+        const auto graph_model_it = graph_models.find(graph_model);
+        if (graph_model_it == graph_models.end()) {
+            throw std::invalid_argument("Unknown graph model: " + graph_model);
+        }
+        settings.graph_model = graph_model_it->second;
+    }
+    if (requests.count("stop_order")) {
+        static const std::unordered_map<std::string_view, routing::StopOrder> stop_orders = {
+                {"first_appearance", routing::StopOrder::FIRST_APPEARANCE},
+                {"hilbert_curve", routing::StopOrder::HILBERT_CURVE}};
+        const auto& stop_order = requests.at("stop_order").AsString();
+        const auto stop_order_it = stop_orders.find(stop_order);
+        if (stop_order_it == stop_orders.end()) {
+            throw std::invalid_argument("Unknown stop order: " + stop_order);
+        }
+        settings.stop_order = stop_order_it->second;
+    }
+    if (requests.count("landmark_count")) {
+        const int landmark_count = requests.at("landmark_count").AsInt();
+        if (landmark_count < 0) {
+            throw std::invalid_argument("Landmark count should not be negative");
+        }
+        settings.landmark_count = static_cast<size_t>(landmark_count);
+    }
+    // in megabytes
+    if (requests.count("memory_budget")) {
+        const double memory_budget = requests.at("memory_budget").AsDouble() * 1024 * 1024;
+        if (!std::isfinite(memory_budget) || memory_budget < 0) {
+            throw std::invalid_argument("Memory budget should be a non-negative number");
+        }
+        // anything past the address space fits as well as the address space itself
+        settings.memory_budget = memory_budget < static_cast<double>(std::numeric_limits<size_t>::max())
+                                 ? static_cast<size_t>(memory_budget)
+                                 : std::numeric_limits<size_t>::max();
+    }
 
     router.SetSettings(std::move(settings));
 }
@@ -276,12 +506,20 @@ void JsonReader::SettingRouter(routing::TransportRouter& router, const json::Dic
 void JsonReader::FormOutput(const RequestHandler& handler, const json::Array& requests, std::ostream& output) {
     static const BusOutputFormer busOutputFormer;
     static const StopOutputFormer stopOutputFormer;
+    static const NearestStopsOutputFormer nearestStopsOutputFormer;
+    static const StopsInBoxOutputFormer stopsInBoxOutputFormer;
     static const RouteOutputFormer routeOutputFormer;
+    static const RouteMatrixOutputFormer routeMatrixOutputFormer;
+    static const IsochroneOutputFormer isochroneOutputFormer;
     static const MapOutputFormer mapOutputFormer;
     static const std::unordered_map<std::string_view, const OutputFormer&> outputFormers = {
             {"Bus"sv, busOutputFormer},
             {"Stop"sv, stopOutputFormer},
+            {"NearestStops"sv, nearestStopsOutputFormer},
+            {"StopsInBox"sv, stopsInBoxOutputFormer},
             {"Route"sv, routeOutputFormer},
+            {"RouteMatrix"sv, routeMatrixOutputFormer},
+            {"Isochrone"sv, isochroneOutputFormer},
             {"Map"sv, mapOutputFormer}
     };
 
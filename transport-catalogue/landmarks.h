@@ -0,0 +1,170 @@
+#pragma once
+
+#include "graph.h"
+#include "search_state.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+namespace graph {
+
+// Lower bounds of route weights from a few landmark vertices (ALT). For every landmark L the
+// weights of the routes L -> v and v -> L are precomputed, and the triangle inequality gives
+// d(v, t) >= d(L, t) - d(L, v) and d(v, t) >= d(v, L) - d(t, L). The largest of these bounds
+// is consistent, so it can direct an A* search; it costs O(landmarks * V) memory.
+template <typename Weight>
+class Landmarks {
+private:
+    using Graph = DirectedWeightedGraph<Weight>;
+
+public:
+    // Everything preprocessing computes. Weights are stored vertex by vertex: the weights of
+    // vertex v are at [v * landmark count, (v + 1) * landmark count).
+    struct Index {
+        std::vector<VertexId> landmarks;
+        std::vector<Weight> from_landmarks;
+        std::vector<Weight> to_landmarks;
+    };
+
+    // Picks the landmarks one by one, each the vertex farthest from the ones already picked;
+    // vertices none of them reaches come first, so every part of the graph gets a landmark.
+    explicit Landmarks(const Graph& graph, size_t landmark_count,
+                       parallel::ThreadPool& thread_pool = parallel::DefaultThreadPool());
+    // Skips preprocessing and uses an index taken from GetIndex.
+    Landmarks(const Graph& graph, Index index);
+
+    const Index& GetIndex() const;
+
+    Weight GetLowerBound(VertexId from, VertexId to) const;
+
+private:
+    static constexpr Weight UNREACHABLE = std::numeric_limits<Weight>::has_infinity
+                                          ? std::numeric_limits<Weight>::infinity()
+                                          : std::numeric_limits<Weight>::max();
+    static constexpr Weight ZERO_WEIGHT{};
+
+    // Weights of the routes from (to, if reverse) the landmark to (from) every vertex v,
+    // written to weights[v * stride]; unreached vertices are left as they are.
+    void Search(VertexId landmark, bool reverse, Weight* weights, size_t stride) const;
+
+    const Graph& graph_;
+    Index index_;
+    ReverseIncidence reverse_incidence_;
+};
+
+template <typename Weight>
+Landmarks<Weight>::Landmarks(const Graph& graph, size_t landmark_count, parallel::ThreadPool& thread_pool)
+    : graph_(graph)
+    , reverse_incidence_(graph)
+{
+    CheckWeightsNonNegative(graph);
+    const size_t vertex_count = graph.GetVertexCount();
+    landmark_count = std::min(landmark_count, vertex_count);
+
+    index_.from_landmarks.assign(vertex_count * landmark_count, UNREACHABLE);
+    index_.to_landmarks.assign(vertex_count * landmark_count, UNREACHABLE);
+    if (landmark_count == 0) {
+        return;
+    }
+
+    index_.landmarks.resize(landmark_count);
+    // for every vertex the weight from the nearest landmark picked so far; before the first
+    // one, the weight from vertex 0, so that the selection starts far from it
+    std::vector<Weight> nearest_weights(vertex_count, UNREACHABLE);
+    Search(0, false, nearest_weights.data(), 1);
+    std::vector<bool> is_landmark(vertex_count, false);
+    for (size_t landmark_index = 0; landmark_index < landmark_count; ++landmark_index) {
+        VertexId farthest = 0;
+        bool found = false;
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            if (!is_landmark[vertex] && (!found || nearest_weights[farthest] < nearest_weights[vertex])) {
+                farthest = vertex;
+                found = true;
+            }
+        }
+        index_.landmarks[landmark_index] = farthest;
+        is_landmark[farthest] = true;
+
+        Search(farthest, false, &index_.from_landmarks[landmark_index], landmark_count);
+        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
+            const Weight weight = index_.from_landmarks[vertex * landmark_count + landmark_index];
+            if (landmark_index == 0 || weight < nearest_weights[vertex]) {
+                nearest_weights[vertex] = weight;
+            }
+        }
+    }
+
+    thread_pool.ParallelFor(landmark_count, [this, landmark_count](size_t landmark_index) {
+        Search(index_.landmarks[landmark_index], true, &index_.to_landmarks[landmark_index], landmark_count);
+    });
+}
+
+template <typename Weight>
+Landmarks<Weight>::Landmarks(const Graph& graph, Index index)
+    : graph_(graph)
+    , index_(std::move(index))
+{
+    const size_t weight_count = graph.GetVertexCount() * index_.landmarks.size();
+    if (index_.from_landmarks.size() != weight_count || index_.to_landmarks.size() != weight_count
+        || std::any_of(index_.landmarks.begin(), index_.landmarks.end(), [&graph](VertexId landmark) {
+               return landmark >= graph.GetVertexCount();
+           })) {
+        throw std::invalid_argument("Landmark index does not match the graph");
+    }
+}
+
+template <typename Weight>
+const typename Landmarks<Weight>::Index& Landmarks<Weight>::GetIndex() const {
+    return index_;
+}
+
+template <typename Weight>
+Weight Landmarks<Weight>::GetLowerBound(VertexId from, VertexId to) const {
+    const size_t landmark_count = index_.landmarks.size();
+    const Weight* from_landmarks_to = index_.from_landmarks.data() + to * landmark_count;
+    const Weight* from_landmarks_from = index_.from_landmarks.data() + from * landmark_count;
+    const Weight* to_landmarks_from = index_.to_landmarks.data() + from * landmark_count;
+    const Weight* to_landmarks_to = index_.to_landmarks.data() + to * landmark_count;
+
+    // a bound is skipped when a landmark misses one of the vertices; if that makes `to`
+    // unreachable from `from`, no route depends on the bound anyway
+    Weight bound = ZERO_WEIGHT;
+    for (size_t i = 0; i < landmark_count; ++i) {
+        if (from_landmarks_to[i] != UNREACHABLE && from_landmarks_from[i] < from_landmarks_to[i]) {
+            bound = std::max(bound, from_landmarks_to[i] - from_landmarks_from[i]);
+        }
+        if (to_landmarks_from[i] != UNREACHABLE && to_landmarks_to[i] < to_landmarks_from[i]) {
+            bound = std::max(bound, to_landmarks_from[i] - to_landmarks_to[i]);
+        }
+    }
+    return bound;
+}
+
+template <typename Weight>
+void Landmarks<Weight>::Search(VertexId landmark, bool reverse, Weight* weights, size_t stride) const {
+    static thread_local SearchState<Weight> search;
+    search.Prepare(graph_.GetVertexCount());
+    search.Relax(landmark, ZERO_WEIGHT, SearchState<Weight>::NO_EDGE);
+
+    typename SearchState<Weight>::QueueItem item;
+    while (search.PopSettled(item)) {
+        weights[item.vertex * stride] = item.weight;
+        if (reverse) {
+            for (const EdgeId edge_id : reverse_incidence_.GetEnteringEdges(item.vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                search.Relax(edge.from, item.weight + edge.weight, edge_id);
+            }
+        } else {
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                search.Relax(edge.to, item.weight + edge.weight, edge_id);
+            }
+        }
+    }
+}
+
+}  // namespace graph
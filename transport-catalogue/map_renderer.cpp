@@ -17,12 +17,12 @@ void MapRenderer::SetSettings(tc::renderer::RenderSettings settings) {
     settings_ = std::move(settings);
 }
 
-void MapRenderer::RenderBusRoute(svg::Document& document, const SphereProjector& projector, const domain::Bus& bus, const svg::Color& color) const
+void MapRenderer::RenderBusRoute(svg::Document& document, const SphereProjector& projector, const catalogue::TransportCatalogue::Bus& bus, const svg::Color& color) const
 {
     auto line = std::make_unique<svg::Polyline>();
 
-    for(const auto stop: bus.stops){
-        auto coords = projector(stop->coordinates);
+    for(const auto& stop: bus.stops){
+        auto coords = projector(stop.coordinates);
         line->AddPoint(coords);
     }
 
@@ -7,7 +7,7 @@
 #include <cassert>
 
 #include "svg.h"
-#include "domain.h"
+#include "transport_catalogue.h"
 
 namespace tc::renderer{
 
@@ -114,7 +114,7 @@ public:
     [[maybe_unused]] const RenderSettings& GetSettings() const;
 
 private:
-    void RenderBusRoute(svg::Document& document, const SphereProjector& projector, const domain::Bus& bus, const svg::Color& color) const;
+    void RenderBusRoute(svg::Document& document, const SphereProjector& projector, const catalogue::TransportCatalogue::Bus& bus, const svg::Color& color) const;
     void RenderBusText(svg::Document& document, const std::string& text, const svg::Point& pos, const svg::Color& color) const;
     void RenderStopSymbol(svg::Document& document, const svg::Point& pos) const;
     void RenderStopText(svg::Document& document, const std::string& text, const svg::Point& pos) const;
@@ -137,28 +137,29 @@ svg::Document MapRenderer::RenderMap(BusInputIt buses_begin, BusInputIt buses_en
 
     svg::Document document;
 
-    std::vector<const domain::Bus*> buses;
-    buses.reserve(std::distance(buses_begin, buses_end));
-    std::transform(buses_begin, buses_end, std::inserter(buses, buses.end()), [](const domain::Bus& bus) {return &bus;});
-    std::sort(buses.begin(), buses.end(), [](const domain::Bus* lhs, const domain::Bus* rhs) {return lhs->name < rhs->name;});
+    using Bus = catalogue::TransportCatalogue::Bus;
+    using Stop = catalogue::TransportCatalogue::Stop;
 
-    std::vector<const domain::Stop*> stops;
+    std::vector<Bus> buses(buses_begin, buses_end);
+    std::sort(buses.begin(), buses.end(), [](const Bus& lhs, const Bus& rhs) {return lhs.name < rhs.name;});
+
+    std::vector<Stop> stops;
     for(auto stop_it = stops_begin; stop_it != stops_end; ++stop_it) {
         if(stop_it->buses.empty()){
             continue;
         }
-        stops.emplace_back(&(*stop_it));
+        stops.emplace_back(*stop_it);
     }
-    std::sort(stops.begin(), stops.end(), [](const domain::Stop* lhs, const domain::Stop* rhs) {return lhs->name < rhs->name;});
+    std::sort(stops.begin(), stops.end(), [](const Stop& lhs, const Stop& rhs) {return lhs.name < rhs.name;});
 
     auto cur_palette_color = settings_.color_palette.begin();
     for(const auto& bus: buses) {
-        if(bus->stops.empty()) {
+        if(bus.stops.empty()) {
             continue;
         }
         assert(cur_palette_color.base());
 
-        RenderBusRoute(document, projector, *bus, *cur_palette_color);
+        RenderBusRoute(document, projector, bus, *cur_palette_color);
 
         ++cur_palette_color;
         cur_palette_color = cur_palette_color == settings_.color_palette.end() ? settings_.color_palette.begin() : cur_palette_color;
@@ -166,19 +167,19 @@ svg::Document MapRenderer::RenderMap(BusInputIt buses_begin, BusInputIt buses_en
 
     cur_palette_color = settings_.color_palette.begin();
     for(const auto& bus: buses) {
-        if(bus->stops.empty()) {
+        if(bus.stops.empty()) {
             continue;
         }
+        const auto first_stop = *bus.stops.begin();
         {
-            auto& stop = bus->stops.front();
-            auto pos = projector(stop->coordinates);
-            RenderBusText(document, bus->name, pos, *cur_palette_color);
+            auto pos = projector(first_stop.coordinates);
+            RenderBusText(document, std::string(bus.name), pos, *cur_palette_color);
         }
-        if(!bus->is_roundtrip) {
-            auto& last_stop = bus->stops[bus->stops.size() / 2];
-            if(last_stop->name != bus->stops.front()->name) {
-                auto pos = projector(last_stop->coordinates);
-                RenderBusText(document, bus->name, pos, *cur_palette_color);
+        if(!bus.is_roundtrip) {
+            const auto last_stop = *std::next(bus.stops.begin(), bus.stops.size() / 2);
+            if(last_stop.name != first_stop.name) {
+                auto pos = projector(last_stop.coordinates);
+                RenderBusText(document, std::string(bus.name), pos, *cur_palette_color);
             }
         }
         ++cur_palette_color;
@@ -186,19 +187,19 @@ svg::Document MapRenderer::RenderMap(BusInputIt buses_begin, BusInputIt buses_en
     }
 
     for(const auto& stop: stops){
-        if(stop->buses.empty()){
+        if(stop.buses.empty()){
             continue;
         }
-        auto coords = projector(stop->coordinates);
+        auto coords = projector(stop.coordinates);
         RenderStopSymbol(document, coords);
     }
 
     for(const auto& stop: stops){
-        if(stop->buses.empty()){
+        if(stop.buses.empty()){
             continue;
         }
-        auto coords = projector(stop->coordinates);
-        RenderStopText(document, stop->name, coords);
+        auto coords = projector(stop.coordinates);
+        RenderStopText(document, std::string(stop.name), coords);
     }
     return document;
 }
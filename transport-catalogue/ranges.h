@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <iterator>
 #include <unordered_map>
 #include <unordered_set>
@@ -21,6 +22,12 @@ public:
     It end() const {
         return end_;
     }
+    size_t size() const {
+        return std::distance(begin_, end_);
+    }
+    bool empty() const {
+        return begin_ == end_;
+    }
 
 private:
     It begin_;
@@ -1,5 +1,7 @@
 #include "request_handler.h"
 
+#include <stdexcept>
+
 namespace tc {
 
 RequestHandler::RequestHandler(const catalogue::TransportCatalogue& db,
@@ -15,9 +17,63 @@ std::optional<catalogue::StopInfo> RequestHandler::GetStopInfo(std::string_view
     return db_.GetStopInfo(stop_name);
 }
 
+std::vector<catalogue::TransportCatalogue::NearbyStop>
+RequestHandler::FindNearestStops(geo::Coordinates coordinates, size_t count) const {
+    return db_.FindNearestStops(coordinates, count);
+}
+
+std::vector<catalogue::TransportCatalogue::Stop>
+RequestHandler::GetStopsInBox(geo::Coordinates min, geo::Coordinates max) const {
+    return db_.GetStopsInBox(min, max);
+}
+
 std::optional<routing::TransportRouter::Route>
-RequestHandler::GetRoute(std::string_view from, std::string_view to) const {
-    return router_.GetRoute(from, to);
+RequestHandler::GetRoute(std::string_view from, std::string_view to,
+                         const routing::TransportRouter::RouteOverrides& overrides) const {
+    return router_.GetRoute(from, to, overrides);
+}
+
+std::optional<routing::TransportRouter::RouteBetweenEnds>
+RequestHandler::GetRoute(const RoutePoint& from, const RoutePoint& to, const WalkSettings& walk_settings,
+                         const routing::TransportRouter::RouteOverrides& overrides) const {
+    if(!(walk_settings.velocity > 0)) {
+        throw std::invalid_argument("Walk velocity should be positive");
+    }
+    const auto get_ends = [this, &walk_settings](const RoutePoint& point) {
+        std::vector<routing::TransportRouter::RouteEnd> ends;
+        if(const auto* stop_name = std::get_if<std::string_view>(&point)) {
+            ends.push_back({*stop_name, 0});
+            return ends;
+        }
+        // a stop no bus serves cannot start or end a route, so more stops are looked at until
+        // enough served ones are found or there are no more
+        for(size_t count = walk_settings.stop_count; ; count *= 2) {
+            const auto nearby_stops = db_.FindNearestStops(std::get<geo::Coordinates>(point), count);
+            ends.clear();
+            for(const auto& nearby_stop: nearby_stops) {
+                if(ends.size() == walk_settings.stop_count) {
+                    break;
+                }
+                if(!nearby_stop.stop.buses.empty()) {
+                    ends.push_back({nearby_stop.stop.name, nearby_stop.distance / walk_settings.velocity});
+                }
+            }
+            if(ends.size() == walk_settings.stop_count || nearby_stops.size() < count) {
+                return ends;
+            }
+        }
+    };
+    return router_.GetRoute(get_ends(from), get_ends(to), overrides);
+}
+
+std::optional<std::vector<routing::TransportRouter::ReachableStop>>
+RequestHandler::GetReachableStops(std::string_view from, double max_time) const {
+    return router_.GetReachableStops(from, max_time);
+}
+
+std::vector<std::vector<std::optional<double>>>
+RequestHandler::GetTravelTimes(const std::vector<std::string_view>& from, const std::vector<std::string_view>& to) const {
+    return router_.GetTravelTimes(from, to);
 }
 
 svg::Document RequestHandler::RenderMap() const {
@@ -3,10 +3,22 @@
 #include "map_renderer.h"
 #include "transport_router.h"
 
+#include <variant>
+
 namespace tc {
 
 class RequestHandler {
 public:
+    // A stop given by name or a point the route walks to or from.
+    using RoutePoint = std::variant<std::string_view, geo::Coordinates>;
+
+    // How a point joins the network: on foot, as the crow flies, to or from its nearest stops.
+    struct WalkSettings {
+        size_t stop_count = 3;
+        // meters per minute
+        double velocity = 5000.0 / 60.0;
+    };
+
     RequestHandler(const catalogue::TransportCatalogue& db,
                    const renderer::MapRenderer& renderer,
                    const routing::TransportRouter& router);
@@ -15,7 +27,26 @@ public:
 
     std::optional<catalogue::StopInfo> GetStopInfo(std::string_view stop_name) const;
 
-    std::optional<routing::TransportRouter::Route> GetRoute(std::string_view from, std::string_view to) const;
+    std::vector<catalogue::TransportCatalogue::NearbyStop> FindNearestStops(geo::Coordinates coordinates,
+                                                                            size_t count) const;
+
+    std::vector<catalogue::TransportCatalogue::Stop> GetStopsInBox(geo::Coordinates min, geo::Coordinates max) const;
+
+    std::optional<routing::TransportRouter::Route> GetRoute(
+            std::string_view from, std::string_view to,
+            const routing::TransportRouter::RouteOverrides& overrides = {}) const;
+
+    // A point is snapped to walk_settings.stop_count nearest stops served by a bus, a stop is taken as it is;
+    // one search then picks the fastest combination.
+    std::optional<routing::TransportRouter::RouteBetweenEnds> GetRoute(
+            const RoutePoint& from, const RoutePoint& to, const WalkSettings& walk_settings,
+            const routing::TransportRouter::RouteOverrides& overrides = {}) const;
+
+    std::optional<std::vector<routing::TransportRouter::ReachableStop>> GetReachableStops(std::string_view from,
+                                                                                          double max_time) const;
+
+    std::vector<std::vector<std::optional<double>>> GetTravelTimes(const std::vector<std::string_view>& from,
+                                                                   const std::vector<std::string_view>& to) const;
 
     svg::Document RenderMap() const;
 
@@ -1,13 +1,17 @@
 #pragma once
 
 #include "graph.h"
+#include "search_state.h"
+#include "thread_pool.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <iterator>
+#include <limits>
 #include <optional>
 #include <stdexcept>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
 #include <vector>
@@ -20,7 +24,15 @@ private:
     using Graph = DirectedWeightedGraph<Weight>;
 
 public:
-    explicit Router(const Graph& graph);
+    explicit Router(const Graph& graph, parallel::ThreadPool& thread_pool = parallel::DefaultThreadPool());
+    // Uses a routes table saved from GetTableData of a router over the same graph in place,
+    // without copying it. The memory has to stay valid and unchanged while the router lives.
+    Router(const Graph& graph, const char* table_data, size_t table_size);
+
+    // The table points into its own storage, so a copy would share it.
+    Router(const Router&) = delete;
+    Router& operator=(const Router&) = delete;
+    Router(Router&&) = default;
 
     struct RouteInfo {
         Weight weight;
@@ -29,89 +41,370 @@ public:
 
     std::optional<RouteInfo> BuildRoute(VertexId from, VertexId to) const;
 
+    // Route weights from every source to every target, row by row; nullopt for unreachable targets.
+    std::vector<std::optional<Weight>> BuildWeightMatrix(const std::vector<VertexId>& sources,
+                                                         const std::vector<VertexId>& targets) const;
+
+    // Marks vertices and edges that have no counterpart in the changed graph passed to Update.
+    static constexpr size_t REMOVED_ID = std::numeric_limits<size_t>::max();
+
+    // Brings the table up to date after the router's graph was changed in place. old_graph is
+    // a copy of the graph the table was built for; new_vertex_ids and new_edge_ids map its
+    // vertices and edges to their ids in the changed graph, or to REMOVED_ID. Only the rows
+    // the change can affect are searched again; the others are copied with remapped ids.
+    void Update(const Graph& old_graph, const std::vector<VertexId>& new_vertex_ids,
+                const std::vector<EdgeId>& new_edge_ids,
+                parallel::ThreadPool& thread_pool = parallel::DefaultThreadPool());
+
+    // The routes table as raw bytes, in the layout the table constructor accepts.
+    const char* GetTableData() const;
+    size_t GetTableSize() const;
+    // The table size of a graph with vertex_count vertices, in bytes.
+    static size_t ComputeTableSize(size_t vertex_count);
+
 private:
+    // The table keeps weights in single precision (integral weights as they are) and
+    // predecessor edges as 32-bit ids, so a cell takes 8 bytes. Unreachable cells hold
+    // UNREACHABLE, and NO_EDGE marks a route without edges. BuildRoute recomputes the
+    // route weight from the graph in full precision.
+    using StoredWeight = std::conditional_t<std::is_floating_point_v<Weight>, float, Weight>;
+    using StoredEdgeId = uint32_t;
+
+    static constexpr StoredWeight UNREACHABLE = std::numeric_limits<StoredWeight>::has_infinity
+                                                ? std::numeric_limits<StoredWeight>::infinity()
+                                                : std::numeric_limits<StoredWeight>::max();
+    static constexpr StoredEdgeId NO_EDGE = std::numeric_limits<StoredEdgeId>::max();
+
     struct RouteInternalData {
-        Weight weight;
-        std::optional<EdgeId> prev_edge;
+        StoredWeight weight = UNREACHABLE;
+        StoredEdgeId prev_edge = NO_EDGE;
     };
-    using RoutesInternalData = std::vector<std::vector<std::optional<RouteInternalData>>>;
+    // Row-major vertex_count x vertex_count matrix in a single allocation.
+    using RoutesInternalData = std::vector<RouteInternalData>;
+
+    RouteInternalData& GetRouteInternalData(VertexId from, VertexId to) {
+        return routes_internal_data_[from * vertex_count_ + to];
+    }
+    const RouteInternalData& GetRouteInternalData(VertexId from, VertexId to) const {
+        return routes_[from * vertex_count_ + to];
+    }
 
     void InitializeRoutesInternalData(const Graph& graph) {
-        const size_t vertex_count = graph.GetVertexCount();
-        for (VertexId vertex = 0; vertex < vertex_count; ++vertex) {
-            routes_internal_data_[vertex][vertex] = RouteInternalData{ZERO_WEIGHT, std::nullopt};
+        if (graph.GetEdgeCount() >= NO_EDGE) {
+            throw std::length_error("Too many edges for the routes table");
+        }
+        for (VertexId vertex = 0; vertex < vertex_count_; ++vertex) {
+            GetRouteInternalData(vertex, vertex) = RouteInternalData{StoredWeight{}, NO_EDGE};
             for (const EdgeId edge_id : graph.GetIncidentEdges(vertex)) {
                 const auto& edge = graph.GetEdge(edge_id);
                 if (edge.weight < ZERO_WEIGHT) {
                     throw std::domain_error("Edges' weights should be non-negative");
                 }
-                auto& route_internal_data = routes_internal_data_[vertex][edge.to];
-                if (!route_internal_data || route_internal_data->weight > edge.weight) {
-                    route_internal_data = RouteInternalData{edge.weight, edge_id};
+                auto& route_internal_data = GetRouteInternalData(vertex, edge.to);
+                const auto weight = static_cast<StoredWeight>(edge.weight);
+                if (route_internal_data.weight == UNREACHABLE || route_internal_data.weight > weight) {
+                    route_internal_data = RouteInternalData{weight, static_cast<StoredEdgeId>(edge_id)};
                 }
             }
         }
     }
 
-    void RelaxRoute(VertexId vertex_from, VertexId vertex_to, const RouteInternalData& route_from,
-                    const RouteInternalData& route_to) {
-        auto& route_relaxing = routes_internal_data_[vertex_from][vertex_to];
-        const Weight candidate_weight = route_from.weight + route_to.weight;
-        if (!route_relaxing || candidate_weight < route_relaxing->weight) {
-            route_relaxing = {candidate_weight,
-                              route_to.prev_edge ? route_to.prev_edge : route_from.prev_edge};
-        }
-    }
+    // The routes to and from every vertex k of the block passed through, as they were right
+    // before the step through k. Row k - (the first vertex of the block) of `to` holds the routes
+    // from every vertex to k, the same row of `from` the routes from k to every vertex.
+    struct ThroughRoutes {
+        RoutesInternalData to;
+        RoutesInternalData from;
+    };
 
-    void RelaxRoutesInternalDataThroughVertex(size_t vertex_count, VertexId vertex_through) {
-        for (VertexId vertex_from = 0; vertex_from < vertex_count; ++vertex_from) {
-            if (const auto& route_from = routes_internal_data_[vertex_from][vertex_through]) {
-                for (VertexId vertex_to = 0; vertex_to < vertex_count; ++vertex_to) {
-                    if (const auto& route_to = routes_internal_data_[vertex_through][vertex_to]) {
-                        RelaxRoute(vertex_from, vertex_to, *route_from, *route_to);
+    // Relaxes every route from a vertex of block_from to a vertex of block_to through every
+    // vertex of block_through, taking the intermediate vertices in ascending order. As in the
+    // plain Floyd–Warshall, the step through k sees the routes to and from k as they were before
+    // it, so ties are resolved the same way. Blocks in the row or the column of block_through
+    // record those routes in through_routes, the other blocks read them from there.
+    void RelaxBlock(size_t block_from, size_t block_to, size_t block_through, ThroughRoutes& through_routes) {
+        const VertexId from_begin = block_from * BLOCK_SIZE;
+        const VertexId from_end = std::min(vertex_count_, (block_from + 1) * BLOCK_SIZE);
+        const VertexId to_begin = block_to * BLOCK_SIZE;
+        const VertexId to_end = std::min(vertex_count_, (block_to + 1) * BLOCK_SIZE);
+        const VertexId through_begin = block_through * BLOCK_SIZE;
+        const VertexId through_end = std::min(vertex_count_, (block_through + 1) * BLOCK_SIZE);
+        for (VertexId vertex_through = through_begin; vertex_through < through_end; ++vertex_through) {
+            const size_t row = (vertex_through - through_begin) * vertex_count_;
+            RouteInternalData* routes_to_through = &through_routes.to[row];
+            RouteInternalData* routes_from_through = &through_routes.from[row];
+            if (block_from == block_through) {
+                const RouteInternalData* routes = &GetRouteInternalData(vertex_through, 0);
+                std::copy(routes + to_begin, routes + to_end, routes_from_through + to_begin);
+            }
+            for (VertexId vertex_from = from_begin; vertex_from < from_end; ++vertex_from) {
+                RouteInternalData* routes_from = &GetRouteInternalData(vertex_from, 0);
+                if (block_to == block_through) {
+                    routes_to_through[vertex_from] = routes_from[vertex_through];
+                }
+                const RouteInternalData route_from = routes_to_through[vertex_from];
+                if (route_from.weight == UNREACHABLE) {
+                    continue;
+                }
+                for (VertexId vertex_to = to_begin; vertex_to < to_end; ++vertex_to) {
+                    const RouteInternalData& route_to = routes_from_through[vertex_to];
+                    if (route_to.weight == UNREACHABLE) {
+                        continue;
+                    }
+                    auto& route_relaxing = routes_from[vertex_to];
+                    const StoredWeight candidate_weight = route_from.weight + route_to.weight;
+                    if (candidate_weight < route_relaxing.weight) {
+                        route_relaxing = {candidate_weight,
+                                          route_to.prev_edge != NO_EDGE ? route_to.prev_edge : route_from.prev_edge};
                     }
                 }
             }
         }
     }
 
+    // One round of blocked Floyd–Warshall: the diagonal block first, then the blocks sharing
+    // its row or column, then all the rest. Blocks within the second and the third phase
+    // only read blocks finished in earlier phases, so they are relaxed in parallel.
+    void RelaxRoutesInternalDataThroughBlock(size_t block_through, ThroughRoutes& through_routes,
+                                             parallel::ThreadPool& thread_pool) {
+        const size_t block_count = (vertex_count_ + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        RelaxBlock(block_through, block_through, block_through, through_routes);
+
+        const size_t other_block_count = block_count - 1;
+        const auto other_block = [block_through](size_t index) {
+            return index < block_through ? index : index + 1;
+        };
+        thread_pool.ParallelFor(other_block_count * 2, [&](size_t task) {
+            const size_t block = other_block(task / 2);
+            if (task % 2 == 0) {
+                RelaxBlock(block_through, block, block_through, through_routes);
+            } else {
+                RelaxBlock(block, block_through, block_through, through_routes);
+            }
+        });
+        thread_pool.ParallelFor(other_block_count * other_block_count, [&](size_t task) {
+            RelaxBlock(other_block(task / other_block_count), other_block(task % other_block_count),
+                       block_through, through_routes);
+        });
+    }
+
+    static constexpr size_t BLOCK_SIZE = 64;
     static constexpr Weight ZERO_WEIGHT{};
     const Graph& graph_;
+    size_t vertex_count_;
+    // empty when the table lives in memory passed to the constructor
     RoutesInternalData routes_internal_data_;
+    const RouteInternalData* routes_;
 };
 
 template <typename Weight>
-Router<Weight>::Router(const Graph& graph)
+Router<Weight>::Router(const Graph& graph, parallel::ThreadPool& thread_pool)
     : graph_(graph)
-    , routes_internal_data_(graph.GetVertexCount(),
-                            std::vector<std::optional<RouteInternalData>>(graph.GetVertexCount()))
+    , vertex_count_(graph.GetVertexCount())
+    , routes_internal_data_(vertex_count_ * vertex_count_)
+    , routes_(routes_internal_data_.data())
 {
     InitializeRoutesInternalData(graph);
 
-    const size_t vertex_count = graph.GetVertexCount();
-    for (VertexId vertex_through = 0; vertex_through < vertex_count; ++vertex_through) {
-        RelaxRoutesInternalDataThroughVertex(vertex_count, vertex_through);
+    const size_t through_routes_size = std::min(BLOCK_SIZE, vertex_count_) * vertex_count_;
+    ThroughRoutes through_routes{RoutesInternalData(through_routes_size), RoutesInternalData(through_routes_size)};
+    const size_t block_count = (vertex_count_ + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    for (size_t block_through = 0; block_through < block_count; ++block_through) {
+        RelaxRoutesInternalDataThroughBlock(block_through, through_routes, thread_pool);
+    }
+}
+
+template <typename Weight>
+Router<Weight>::Router(const Graph& graph, const char* table_data, size_t table_size)
+    : graph_(graph)
+    , vertex_count_(graph.GetVertexCount())
+    , routes_(reinterpret_cast<const RouteInternalData*>(table_data))
+{
+    static_assert(std::is_trivially_copyable_v<RouteInternalData>);
+    if (table_size != vertex_count_ * vertex_count_ * sizeof(RouteInternalData)) {
+        throw std::invalid_argument("Routes table does not match the graph");
+    }
+    if (reinterpret_cast<uintptr_t>(table_data) % alignof(RouteInternalData) != 0) {
+        throw std::invalid_argument("Routes table is misaligned");
     }
 }
 
+// A row can only change if one of its routes uses an edge that is gone or got heavier, or if
+// a new or lighter edge u -> v beats the row's route to v when appended to its route to u.
+// The first changed edge of any improved route leaves an old vertex, so checking the
+// edges one by one against the old table is enough.
+template <typename Weight>
+void Router<Weight>::Update(const Graph& old_graph, const std::vector<VertexId>& new_vertex_ids,
+                            const std::vector<EdgeId>& new_edge_ids, parallel::ThreadPool& thread_pool) {
+    const size_t old_vertex_count = vertex_count_;
+    const size_t new_vertex_count = graph_.GetVertexCount();
+    if (old_graph.GetVertexCount() != old_vertex_count || new_vertex_ids.size() != old_vertex_count
+        || new_edge_ids.size() != old_graph.GetEdgeCount()) {
+        throw std::invalid_argument("Id mappings do not match the old graph");
+    }
+    if (graph_.GetEdgeCount() >= NO_EDGE) {
+        throw std::length_error("Too many edges for the routes table");
+    }
+
+    std::vector<VertexId> old_vertex_ids(new_vertex_count, REMOVED_ID);
+    for (VertexId vertex = 0; vertex < old_vertex_count; ++vertex) {
+        if (new_vertex_ids[vertex] != REMOVED_ID) {
+            old_vertex_ids.at(new_vertex_ids[vertex]) = vertex;
+        }
+    }
+
+    std::vector<char> is_broken(old_graph.GetEdgeCount(), false);
+    std::vector<char> is_kept(graph_.GetEdgeCount(), false);
+    for (EdgeId edge_id = 0; edge_id < old_graph.GetEdgeCount(); ++edge_id) {
+        const EdgeId new_edge_id = new_edge_ids[edge_id];
+        if (new_edge_id == REMOVED_ID || old_graph.GetEdge(edge_id).weight < graph_.GetEdge(new_edge_id).weight) {
+            is_broken[edge_id] = true;
+        }
+        if (new_edge_id != REMOVED_ID && !(graph_.GetEdge(new_edge_id).weight < old_graph.GetEdge(edge_id).weight)) {
+            is_kept[new_edge_id] = true;
+        }
+    }
+    struct ImprovedEdge {
+        VertexId old_from;
+        VertexId old_to;  // REMOVED_ID for a new vertex
+        StoredWeight weight;
+    };
+    std::vector<ImprovedEdge> improved_edges;
+    for (EdgeId edge_id = 0; edge_id < graph_.GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_.GetEdge(edge_id);
+        if (edge.weight < ZERO_WEIGHT) {
+            throw std::domain_error("Edges' weights should be non-negative");
+        }
+        if (!is_kept[edge_id] && old_vertex_ids[edge.from] != REMOVED_ID) {
+            improved_edges.push_back({old_vertex_ids[edge.from], old_vertex_ids[edge.to],
+                                      static_cast<StoredWeight>(edge.weight)});
+        }
+    }
+
+    std::vector<char> is_affected(old_vertex_count, false);
+    thread_pool.ParallelFor(old_vertex_count, [&](size_t vertex_from) {
+        if (new_vertex_ids[vertex_from] == REMOVED_ID) {
+            return;
+        }
+        const RouteInternalData* row = &GetRouteInternalData(vertex_from, 0);
+        bool affected = std::any_of(row, row + old_vertex_count, [&is_broken](const RouteInternalData& route) {
+            return route.prev_edge != NO_EDGE && is_broken[route.prev_edge];
+        });
+        for (auto it = improved_edges.begin(); !affected && it != improved_edges.end(); ++it) {
+            const StoredWeight weight_from = row[it->old_from].weight;
+            affected = weight_from != UNREACHABLE
+                       && (it->old_to == REMOVED_ID || !(row[it->old_to].weight < weight_from + it->weight));
+        }
+        is_affected[vertex_from] = affected;
+    });
+
+    RoutesInternalData routes_internal_data(new_vertex_count * new_vertex_count);
+    thread_pool.ParallelFor(new_vertex_count, [&](size_t vertex_from) {
+        RouteInternalData* new_row = routes_internal_data.data() + vertex_from * new_vertex_count;
+        const VertexId old_vertex_from = old_vertex_ids[vertex_from];
+        if (old_vertex_from != REMOVED_ID && !is_affected[old_vertex_from]) {
+            const RouteInternalData* row = &GetRouteInternalData(old_vertex_from, 0);
+            for (VertexId vertex_to = 0; vertex_to < old_vertex_count; ++vertex_to) {
+                if (new_vertex_ids[vertex_to] != REMOVED_ID) {
+                    RouteInternalData route = row[vertex_to];
+                    if (route.prev_edge != NO_EDGE) {
+                        route.prev_edge = static_cast<StoredEdgeId>(new_edge_ids[route.prev_edge]);
+                    }
+                    new_row[new_vertex_ids[vertex_to]] = route;
+                }
+            }
+            return;
+        }
+
+        static thread_local SearchState<Weight> search;
+        search.Prepare(new_vertex_count);
+        search.Relax(vertex_from, ZERO_WEIGHT, SearchState<Weight>::NO_EDGE);
+        typename SearchState<Weight>::QueueItem item;
+        while (search.PopSettled(item)) {
+            const EdgeId prev_edge = search.GetPrevEdge(item.vertex);
+            new_row[item.vertex] = {static_cast<StoredWeight>(item.weight),
+                                    prev_edge == SearchState<Weight>::NO_EDGE ? NO_EDGE
+                                                                              : static_cast<StoredEdgeId>(prev_edge)};
+            for (const EdgeId edge_id : graph_.GetIncidentEdges(item.vertex)) {
+                const auto& edge = graph_.GetEdge(edge_id);
+                search.Relax(edge.to, item.weight + edge.weight, edge_id);
+            }
+        }
+    });
+
+    routes_internal_data_ = std::move(routes_internal_data);
+    routes_ = routes_internal_data_.data();
+    vertex_count_ = new_vertex_count;
+}
+
+template <typename Weight>
+const char* Router<Weight>::GetTableData() const {
+    return reinterpret_cast<const char*>(routes_);
+}
+
+template <typename Weight>
+size_t Router<Weight>::GetTableSize() const {
+    return ComputeTableSize(vertex_count_);
+}
+
+template <typename Weight>
+size_t Router<Weight>::ComputeTableSize(size_t vertex_count) {
+    return vertex_count * vertex_count * sizeof(RouteInternalData);
+}
+
 template <typename Weight>
 std::optional<typename Router<Weight>::RouteInfo> Router<Weight>::BuildRoute(VertexId from,
                                                                              VertexId to) const {
-    const auto& route_internal_data = routes_internal_data_.at(from).at(to);
-    if (!route_internal_data) {
+    if (from >= vertex_count_ || to >= vertex_count_) {
+        throw std::out_of_range("Vertex id is out of range");
+    }
+    const auto& route_internal_data = GetRouteInternalData(from, to);
+    if (route_internal_data.weight == UNREACHABLE) {
         return std::nullopt;
     }
-    const Weight weight = route_internal_data->weight;
+    Weight weight = ZERO_WEIGHT;
     std::vector<EdgeId> edges;
-    for (std::optional<EdgeId> edge_id = route_internal_data->prev_edge;
-         edge_id;
-         edge_id = routes_internal_data_[from][graph_.GetEdge(*edge_id).from]->prev_edge)
+    for (StoredEdgeId edge_id = route_internal_data.prev_edge;
+         edge_id != NO_EDGE;
+         edge_id = GetRouteInternalData(from, graph_.GetEdge(edge_id).from).prev_edge)
     {
-        edges.push_back(*edge_id);
+        edges.push_back(edge_id);
     }
     std::reverse(edges.begin(), edges.end());
+    for (const EdgeId edge_id : edges) {
+        weight += graph_.GetEdge(edge_id).weight;
+    }
 
     return RouteInfo{weight, std::move(edges)};
 }
 
+// Sums the edges of every route without collecting them, still in full precision.
+template <typename Weight>
+std::vector<std::optional<Weight>> Router<Weight>::BuildWeightMatrix(const std::vector<VertexId>& sources,
+                                                                     const std::vector<VertexId>& targets) const {
+    std::vector<std::optional<Weight>> weights;
+    weights.reserve(sources.size() * targets.size());
+    for (const VertexId from : sources) {
+        for (const VertexId to : targets) {
+            if (from >= vertex_count_ || to >= vertex_count_) {
+                throw std::out_of_range("Vertex id is out of range");
+            }
+            const auto& route_internal_data = GetRouteInternalData(from, to);
+            if (route_internal_data.weight == UNREACHABLE) {
+                weights.emplace_back();
+                continue;
+            }
+            Weight weight = ZERO_WEIGHT;
+            for (StoredEdgeId edge_id = route_internal_data.prev_edge;
+                 edge_id != NO_EDGE;
+                 edge_id = GetRouteInternalData(from, graph_.GetEdge(edge_id).from).prev_edge)
+            {
+                weight += graph_.GetEdge(edge_id).weight;
+            }
+            weights.emplace_back(weight);
+        }
+    }
+    return weights;
+}
+
 }  // namespace graph
\ No newline at end of file
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "graph.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace graph {
+
+// Buffers of a single-source Dijkstra search that are reused between queries.
+// Vertices touched by an earlier query are recognized by a stale visit mark,
+// so nothing is cleared between searches.
+template <typename Weight>
+class SearchState {
+public:
+    static constexpr EdgeId NO_EDGE = static_cast<EdgeId>(-1);
+
+    // The queue is ordered by key: the weight itself for Dijkstra, weight plus a lower bound
+    // of the remaining distance for goal-directed searches.
+    struct QueueItem {
+        Weight key;
+        Weight weight;
+        VertexId vertex;
+
+        bool operator>(const QueueItem& other) const {
+            return key > other.key;
+        }
+    };
+
+    void Prepare(size_t vertex_count) {
+        if (visit_marks_.size() < vertex_count) {
+            weights_.resize(vertex_count);
+            prev_edges_.resize(vertex_count);
+            visit_marks_.resize(vertex_count, 0);
+        }
+        if (++current_mark_ == 0) {
+            std::fill(visit_marks_.begin(), visit_marks_.end(), 0);
+            current_mark_ = 1;
+        }
+        heap_.clear();
+        settled_count_ = 0;
+    }
+
+    bool IsReached(VertexId vertex) const {
+        return visit_marks_[vertex] == current_mark_;
+    }
+
+    Weight GetWeight(VertexId vertex) const {
+        return weights_[vertex];
+    }
+
+    EdgeId GetPrevEdge(VertexId vertex) const {
+        return prev_edges_[vertex];
+    }
+
+    // Records a tentative weight and pushes the vertex to the queue if it improves on the known one.
+    bool Relax(VertexId vertex, Weight weight, EdgeId prev_edge, Weight potential = Weight{}) {
+        if (IsReached(vertex) && !(weight < weights_[vertex])) {
+            return false;
+        }
+        visit_marks_[vertex] = current_mark_;
+        weights_[vertex] = weight;
+        prev_edges_[vertex] = prev_edge;
+        Push(weight + potential, weight, vertex);
+        return true;
+    }
+
+    bool IsQueueEmpty() const {
+        return heap_.empty();
+    }
+
+    const QueueItem& Top() const {
+        return heap_.front();
+    }
+
+    // Pops queue items until one is not outdated by a later Relax of the same vertex.
+    // Returns false when the queue runs out.
+    bool PopSettled(QueueItem& item) {
+        while (!heap_.empty()) {
+            std::pop_heap(heap_.begin(), heap_.end(), std::greater<QueueItem>{});
+            item = heap_.back();
+            heap_.pop_back();
+            if (!(weights_[item.vertex] < item.weight)) {
+                ++settled_count_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ClearQueue() {
+        heap_.clear();
+    }
+
+    // Number of vertices settled since the last Prepare.
+    size_t GetSettledCount() const {
+        return settled_count_;
+    }
+
+private:
+    void Push(Weight key, Weight weight, VertexId vertex) {
+        heap_.push_back({key, weight, vertex});
+        std::push_heap(heap_.begin(), heap_.end(), std::greater<QueueItem>{});
+    }
+
+    std::vector<Weight> weights_;
+    std::vector<EdgeId> prev_edges_;
+    std::vector<uint32_t> visit_marks_;
+    uint32_t current_mark_ = 0;
+    std::vector<QueueItem> heap_;
+    size_t settled_count_ = 0;
+};
+
+}  // namespace graph
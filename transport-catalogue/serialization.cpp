@@ -0,0 +1,133 @@
+#include "serialization.h"
+
+#include <cstdio>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace serialization {
+
+MappedFile::MappedFile(const std::string& path) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+        close(fd);
+        throw std::runtime_error("Cannot map " + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + path);
+    }
+    data_ = static_cast<const char*>(data);
+}
+
+MappedFile::~MappedFile() {
+    munmap(const_cast<char*>(data_), size_);
+}
+
+const char* MappedFile::GetData() const {
+    return data_;
+}
+
+size_t MappedFile::GetSize() const {
+    return size_;
+}
+
+BinaryWriter::BinaryWriter(std::string path)
+    : path_(std::move(path))
+    , temp_path_(path_ + ".tmp")
+    , output_(temp_path_, std::ios::binary | std::ios::trunc) {
+    if (!output_) {
+        throw std::runtime_error("Cannot write " + temp_path_);
+    }
+}
+
+void BinaryWriter::WriteStrings(const std::vector<std::string_view>& strings) {
+    std::vector<uint64_t> offsets;
+    offsets.reserve(strings.size() + 1);
+    offsets.push_back(0);
+    std::string characters;
+    for (const auto string : strings) {
+        characters += string;
+        offsets.push_back(characters.size());
+    }
+    WriteArray(characters.data(), characters.size());
+    WriteArray(offsets);
+}
+
+void BinaryWriter::Commit() {
+    output_.close();
+    if (!output_ || std::rename(temp_path_.c_str(), path_.c_str()) != 0) {
+        std::remove(temp_path_.c_str());
+        throw std::runtime_error("Cannot write " + path_);
+    }
+}
+
+void BinaryWriter::WriteBytes(const void* data, size_t size) {
+    output_.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+    position_ += size;
+}
+
+void BinaryWriter::Align() {
+    static constexpr char PADDING[ALIGNMENT] = {};
+    WriteBytes(PADDING, (ALIGNMENT - position_ % ALIGNMENT) % ALIGNMENT);
+}
+
+BinaryReader::BinaryReader(const char* data, size_t size)
+    : data_(data)
+    , size_(size) {
+}
+
+std::vector<std::string_view> BinaryReader::ReadStrings() {
+    const auto characters = ReadArray<char>();
+    const auto offsets = ReadArray<uint64_t>();
+    const size_t character_count = characters.end() - characters.begin();
+    std::vector<std::string_view> strings;
+    for (const uint64_t* it = offsets.begin(); it != offsets.end() && it + 1 != offsets.end(); ++it) {
+        if (it[0] > it[1] || it[1] > character_count) {
+            throw FormatError("String runs past the end of the data");
+        }
+        strings.emplace_back(characters.begin() + it[0], it[1] - it[0]);
+    }
+    return strings;
+}
+
+const char* BinaryReader::ReadBytes(size_t size) {
+    if (size > size_ - position_) {
+        throw FormatError("Unexpected end of the data");
+    }
+    const char* bytes = data_ + position_;
+    position_ += size;
+    return bytes;
+}
+
+void BinaryReader::Align() {
+    ReadBytes((BinaryWriter::ALIGNMENT - position_ % BinaryWriter::ALIGNMENT) % BinaryWriter::ALIGNMENT);
+}
+
+Hasher& Hasher::Add(std::string_view value) {
+    Add(static_cast<uint64_t>(value.size()));
+    return AddBytes(value.data(), value.size());
+}
+
+uint64_t Hasher::GetHash() const {
+    return hash_;
+}
+
+Hasher& Hasher::AddBytes(const void* data, size_t size) {
+    const auto* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash_ ^= bytes[i];
+        hash_ *= 1099511628211ull;
+    }
+    return *this;
+}
+
+}  // namespace serialization
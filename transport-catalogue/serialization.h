@@ -0,0 +1,160 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+#include "ranges.h"
+
+namespace serialization {
+
+class FormatError : public std::runtime_error {
+public:
+    using runtime_error::runtime_error;
+};
+
+// A whole file mapped read-only into memory. The mapping lives as long as the object.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    const char* GetData() const;
+    size_t GetSize() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+// Writes trivially copyable values and arrays in native byte order. Every array is
+// preceded by its length and aligned to ALIGNMENT, so a reader can use it in place.
+// The file appears under its name only after Commit, so readers never see it half written.
+class BinaryWriter {
+public:
+    static constexpr size_t ALIGNMENT = 8;
+
+    explicit BinaryWriter(std::string path);
+
+    template <typename T>
+    void Write(const T& value);
+
+    template <typename T>
+    void WriteArray(const T* data, size_t count);
+
+    template <typename T>
+    void WriteArray(const std::vector<T>& values) {
+        WriteArray(values.data(), values.size());
+    }
+
+    // Writes the characters of all the strings followed by their offsets.
+    void WriteStrings(const std::vector<std::string_view>& strings);
+
+    void Commit();
+
+private:
+    void WriteBytes(const void* data, size_t size);
+    void Align();
+
+    std::string path_;
+    std::string temp_path_;
+    std::ofstream output_;
+    size_t position_ = 0;
+};
+
+// Reads what BinaryWriter wrote from memory, without copying arrays. Throws FormatError
+// when the data ends early or does not fit.
+class BinaryReader {
+public:
+    template <typename T>
+    using ArrayView = ranges::Range<const T*>;
+
+    BinaryReader(const char* data, size_t size);
+
+    template <typename T>
+    T Read();
+
+    template <typename T>
+    ArrayView<T> ReadArray();
+
+    // The views point into the reader's memory.
+    std::vector<std::string_view> ReadStrings();
+
+private:
+    const char* ReadBytes(size_t size);
+    void Align();
+
+    const char* data_;
+    size_t size_;
+    size_t position_ = 0;
+};
+
+// FNV-1a over the bytes of the values added to it.
+class Hasher {
+public:
+    template <typename T>
+    Hasher& Add(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        return AddBytes(&value, sizeof(T));
+    }
+
+    Hasher& Add(std::string_view value);
+
+    uint64_t GetHash() const;
+
+private:
+    Hasher& AddBytes(const void* data, size_t size);
+
+    uint64_t hash_ = 14695981039346656037ull;
+};
+
+template <typename T>
+void BinaryWriter::Write(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    WriteBytes(&value, sizeof(T));
+}
+
+template <typename T>
+void BinaryWriter::WriteArray(const T* data, size_t count) {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= ALIGNMENT);
+    Write(static_cast<uint64_t>(count));
+    Align();
+    WriteBytes(data, count * sizeof(T));
+    Align();
+}
+
+template <typename T>
+T BinaryReader::Read() {
+    static_assert(std::is_trivially_copyable_v<T>);
+    T value;
+    std::char_traits<char>::copy(reinterpret_cast<char*>(&value), ReadBytes(sizeof(T)), sizeof(T));
+    return value;
+}
+
+template <typename T>
+BinaryReader::ArrayView<T> BinaryReader::ReadArray() {
+    static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= BinaryWriter::ALIGNMENT);
+    const auto count = Read<uint64_t>();
+    Align();
+    if (count > (size_ - position_) / sizeof(T)) {
+        throw FormatError("Array runs past the end of the data");
+    }
+    const char* bytes = ReadBytes(count * sizeof(T));
+    if (reinterpret_cast<uintptr_t>(bytes) % alignof(T) != 0) {
+        throw FormatError("Misaligned array");
+    }
+    const auto* begin = reinterpret_cast<const T*>(bytes);
+    Align();
+    return {begin, begin + count};
+}
+
+}  // namespace serialization
@@ -0,0 +1,207 @@
+#define _USE_MATH_DEFINES
+#include "stop_grid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace tc::catalogue {
+
+namespace {
+
+constexpr double EARTH_RADIUS = 6371000;
+constexpr double DEGREE = M_PI / 180.;
+// geo::ComputeDistance goes through acos, which is off by up to a decimeter for close points,
+// so the bounds are lowered by this much not to skip a stop it puts closer than it is
+constexpr double DISTANCE_SLACK = 1;
+
+bool IsCloser(const StopGrid::Neighbour& lhs, const StopGrid::Neighbour& rhs) {
+    return lhs.distance < rhs.distance || (lhs.distance == rhs.distance && lhs.id < rhs.id);
+}
+
+}
+
+StopGrid::StopGrid(const std::vector<double>& latitudes, const std::vector<double>& longitudes) {
+    const size_t stop_count = latitudes.size();
+    if (stop_count == 0) {
+        return;
+    }
+    min_ = max_ = {latitudes[0], longitudes[0]};
+    for (size_t i = 0; i < stop_count; ++i) {
+        min_ = {std::min(min_.lat, latitudes[i]), std::min(min_.lng, longitudes[i])};
+        max_ = {std::max(max_.lat, latitudes[i]), std::max(max_.lng, longitudes[i])};
+    }
+    max_abs_lat_ = std::max(std::abs(min_.lat), std::abs(max_.lat));
+
+    const double height = max_.lat - min_.lat;
+    const double width = (max_.lng - min_.lng) * std::cos((min_.lat + max_.lat) / 2 * DEGREE);
+    const double cell_count = std::max(1., stop_count / 2.);
+    double row_count = 1;
+    double column_count = 1;
+    if (height > 0 && width > 0) {
+        const double side = std::sqrt(height * width / cell_count);
+        row_count = std::ceil(height / side);
+        column_count = std::ceil(width / side);
+    } else if (height > 0) {
+        row_count = cell_count;
+    } else if (width > 0) {
+        column_count = cell_count;
+    }
+    // a narrow strip of stops would get a side far longer than the cell count otherwise
+    row_count_ = static_cast<size_t>(std::clamp(row_count, 1., cell_count));
+    column_count_ = static_cast<size_t>(std::clamp(column_count, 1., cell_count));
+    if (height > 0) {
+        cell_height_ = height / row_count_;
+    }
+    if (max_.lng > min_.lng) {
+        cell_width_ = (max_.lng - min_.lng) / column_count_;
+    }
+
+    // counting sort of the stops by cell
+    std::vector<size_t> stop_cells(stop_count);
+    cell_offsets_.assign(row_count_ * column_count_ + 1, 0);
+    for (size_t i = 0; i < stop_count; ++i) {
+        stop_cells[i] = GetRow(latitudes[i]) * column_count_ + GetColumn(longitudes[i]);
+        ++cell_offsets_[stop_cells[i] + 1];
+    }
+    for (size_t cell = 0; cell + 1 < cell_offsets_.size(); ++cell) {
+        cell_offsets_[cell + 1] += cell_offsets_[cell];
+    }
+    std::vector<size_t> positions(cell_offsets_.begin(), cell_offsets_.end() - 1);
+    ids_.resize(stop_count);
+    latitudes_.resize(stop_count);
+    longitudes_.resize(stop_count);
+    for (size_t i = 0; i < stop_count; ++i) {
+        const size_t position = positions[stop_cells[i]]++;
+        ids_[position] = static_cast<StopId>(i);
+        latitudes_[position] = latitudes[i];
+        longitudes_[position] = longitudes[i];
+    }
+}
+
+std::vector<StopGrid::Neighbour> StopGrid::FindNearest(geo::Coordinates point, size_t count) const {
+    count = std::min(count, ids_.size());
+    if (count == 0) {
+        return {};
+    }
+
+    // a max-heap of the closest stops found so far
+    std::vector<Neighbour> heap;
+    heap.reserve(count + 1);
+    const size_t row = GetRow(point.lat);
+    const size_t column = GetColumn(point.lng);
+    // scans the rings of cells around the cell of the point until no stop outside the scanned
+    // block can be closer than the farthest one found
+    for (size_t radius = 0;; ++radius) {
+        const size_t row_begin = row - std::min(row, radius);
+        const size_t row_end = std::min(row_count_, row + radius + 1);
+        const size_t column_begin = column - std::min(column, radius);
+        const size_t column_end = std::min(column_count_, column + radius + 1);
+        for (size_t ring_row = row_begin; ring_row < row_end; ++ring_row) {
+            if (ring_row + radius == row || ring_row == row + radius) {
+                for (size_t ring_column = column_begin; ring_column < column_end; ++ring_column) {
+                    ScanCell(ring_row, ring_column, point, count, heap);
+                }
+                continue;
+            }
+            if (column >= radius) {
+                ScanCell(ring_row, column - radius, point, count, heap);
+            }
+            if (column + radius < column_count_) {
+                ScanCell(ring_row, column + radius, point, count, heap);
+            }
+        }
+
+        const bool is_all_scanned = row_begin == 0 && row_end == row_count_
+                                    && column_begin == 0 && column_end == column_count_;
+        if (is_all_scanned || (heap.size() == count && heap.front().distance
+                               < GetDistanceOutside(point, row_begin, row_end, column_begin, column_end))) {
+            break;
+        }
+    }
+
+    std::sort_heap(heap.begin(), heap.end(), IsCloser);
+    return heap;
+}
+
+std::vector<StopGrid::StopId> StopGrid::FindInBox(geo::Coordinates min, geo::Coordinates max) const {
+    std::vector<StopId> result;
+    if (ids_.empty() || min.lat > max.lat || min.lng > max.lng) {
+        return result;
+    }
+    const size_t row_end = GetRow(max.lat) + 1;
+    const size_t column_begin = GetColumn(min.lng);
+    const size_t column_end = GetColumn(max.lng) + 1;
+    for (size_t row = GetRow(min.lat); row < row_end; ++row) {
+        // the cells of a row are adjacent, so the stops of its columns in the box are too
+        const size_t begin = cell_offsets_[row * column_count_ + column_begin];
+        const size_t end = cell_offsets_[row * column_count_ + column_end];
+        for (size_t i = begin; i < end; ++i) {
+            if (min.lat <= latitudes_[i] && latitudes_[i] <= max.lat
+                && min.lng <= longitudes_[i] && longitudes_[i] <= max.lng) {
+                result.push_back(ids_[i]);
+            }
+        }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+size_t StopGrid::GetRow(double lat) const {
+    const double row = std::floor((lat - min_.lat) / cell_height_);
+    return static_cast<size_t>(std::clamp(row, 0., static_cast<double>(row_count_ - 1)));
+}
+
+size_t StopGrid::GetColumn(double lng) const {
+    const double column = std::floor((lng - min_.lng) / cell_width_);
+    return static_cast<size_t>(std::clamp(column, 0., static_cast<double>(column_count_ - 1)));
+}
+
+void StopGrid::ScanCell(size_t row, size_t column, geo::Coordinates point, size_t count,
+                        std::vector<Neighbour>& heap) const {
+    const size_t cell = row * column_count_ + column;
+    for (size_t i = cell_offsets_[cell]; i < cell_offsets_[cell + 1]; ++i) {
+        const Neighbour neighbour{ids_[i], geo::ComputeDistance(point, {latitudes_[i], longitudes_[i]})};
+        if (heap.size() < count) {
+            heap.push_back(neighbour);
+            std::push_heap(heap.begin(), heap.end(), IsCloser);
+        } else if (IsCloser(neighbour, heap.front())) {
+            std::pop_heap(heap.begin(), heap.end(), IsCloser);
+            heap.back() = neighbour;
+            std::push_heap(heap.begin(), heap.end(), IsCloser);
+        }
+    }
+}
+
+double StopGrid::GetDistanceOutside(geo::Coordinates point, size_t row_begin, size_t row_end,
+                                    size_t column_begin, size_t column_end) const {
+    // A stop outside lies beyond one of the sides of the block. Beyond a parallel it is at least
+    // the meridian arc away; beyond a meridian the haversine formula gives
+    // hav(d) >= cos(lat1) * cos(lat2) * hav(dlng) >= cos(max_lat)^2 * hav(dlng),
+    // while dlng stays within 180 degrees, where hav grows with it.
+    const double lat_scale = std::cos(std::min(90., std::max(max_abs_lat_, std::abs(point.lat))) * DEGREE);
+    const auto across_meridians = [lat_scale](double lng_gap) {
+        return 2 * EARTH_RADIUS * std::asin(std::min(1., lat_scale * std::sin(lng_gap * DEGREE / 2)));
+    };
+
+    double distance = std::numeric_limits<double>::infinity();
+    if (row_begin > 0) {
+        const double gap = point.lat - (min_.lat + row_begin * cell_height_);
+        distance = std::min(distance, std::max(0., gap) * DEGREE * EARTH_RADIUS);
+    }
+    if (row_end < row_count_) {
+        const double gap = min_.lat + row_end * cell_height_ - point.lat;
+        distance = std::min(distance, std::max(0., gap) * DEGREE * EARTH_RADIUS);
+    }
+    if (column_begin > 0) {
+        const double gap = point.lng - (min_.lng + column_begin * cell_width_);
+        distance = std::min(distance, gap > 0 && point.lng - min_.lng <= 180 ? across_meridians(gap) : 0.);
+    }
+    if (column_end < column_count_) {
+        const double gap = min_.lng + column_end * cell_width_ - point.lng;
+        distance = std::min(distance, gap > 0 && max_.lng - point.lng <= 180 ? across_meridians(gap) : 0.);
+    }
+    return distance - DISTANCE_SLACK;
+}
+
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "domain.h"
+#include "geo.h"
+
+namespace tc::catalogue {
+
+// A uniform grid over the coordinates of the stops with about two stops per cell. The stops are
+// stored cell by cell, so a query reads only the cells around the point or inside the box.
+// The cells are square on the ground at the middle latitude of the stops.
+class StopGrid {
+public:
+    using StopId = domain::StopId;
+
+    struct Neighbour {
+        StopId id;
+        double distance;
+    };
+
+    StopGrid() = default;
+    // Stop i is at (latitudes[i], longitudes[i]).
+    StopGrid(const std::vector<double>& latitudes, const std::vector<double>& longitudes);
+
+    // The `count` stops closest to the point as geo::ComputeDistance measures it, nearest first,
+    // the smaller id first among equally distant ones.
+    std::vector<Neighbour> FindNearest(geo::Coordinates point, size_t count) const;
+
+    // The stops inside the box, its border included, by id.
+    std::vector<StopId> FindInBox(geo::Coordinates min, geo::Coordinates max) const;
+
+private:
+    // the row and the column of the cell holding the point, or of the nearest cell if it is outside
+    size_t GetRow(double lat) const;
+    size_t GetColumn(double lng) const;
+
+    void ScanCell(size_t row, size_t column, geo::Coordinates point, size_t count,
+                  std::vector<Neighbour>& heap) const;
+    // A lower bound of the distance from the point to a stop outside the rows [row_begin, row_end)
+    // and the columns [column_begin, column_end).
+    double GetDistanceOutside(geo::Coordinates point, size_t row_begin, size_t row_end,
+                              size_t column_begin, size_t column_end) const;
+
+    geo::Coordinates min_ = {0, 0};
+    geo::Coordinates max_ = {0, 0};
+    // the largest absolute latitude of a stop
+    double max_abs_lat_ = 0;
+    // in degrees
+    double cell_height_ = 1;
+    double cell_width_ = 1;
+    size_t row_count_ = 0;
+    size_t column_count_ = 0;
+
+    // the stops of the cell in row r and column c are at [cell_offsets_[i], cell_offsets_[i + 1])
+    // of the arrays below, where i = r * column_count_ + c
+    std::vector<size_t> cell_offsets_;
+    std::vector<StopId> ids_;
+    std::vector<double> latitudes_;
+    std::vector<double> longitudes_;
+};
+
+}
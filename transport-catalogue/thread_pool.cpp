@@ -0,0 +1,105 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace parallel {
+
+ThreadPool::ThreadPool(size_t thread_count) {
+    if (thread_count == 0) {
+        thread_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers_.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; ++i) {
+        workers_.emplace_back([this] { WorkerLoop(); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (auto& worker : workers_) {
+        worker.join();
+    }
+}
+
+size_t ThreadPool::GetThreadCount() const {
+    return workers_.size() + 1;
+}
+
+void ThreadPool::ParallelFor(size_t task_count, const std::function<void(size_t)>& task) {
+    if (task_count == 0) {
+        return;
+    }
+    if (workers_.empty() || task_count == 1) {
+        for (size_t index = 0; index < task_count; ++index) {
+            task(index);
+        }
+        return;
+    }
+
+    std::lock_guard call_lock(call_mutex_);
+    {
+        std::lock_guard lock(mutex_);
+        task_ = &task;
+        task_count_ = task_count;
+        next_task_ = 0;
+        busy_workers_ = workers_.size();
+        error_ = nullptr;
+        ++generation_;
+    }
+    work_ready_.notify_all();
+
+    RunTasks();
+
+    std::unique_lock lock(mutex_);
+    work_done_.wait(lock, [this] { return busy_workers_ == 0; });
+    task_ = nullptr;
+    if (error_) {
+        std::rethrow_exception(std::exchange(error_, nullptr));
+    }
+}
+
+void ThreadPool::WorkerLoop() {
+    uint64_t seen_generation = 0;
+    while (true) {
+        {
+            std::unique_lock lock(mutex_);
+            work_ready_.wait(lock, [&] { return stopping_ || generation_ != seen_generation; });
+            if (stopping_) {
+                return;
+            }
+            seen_generation = generation_;
+        }
+
+        RunTasks();
+
+        std::lock_guard lock(mutex_);
+        if (--busy_workers_ == 0) {
+            work_done_.notify_one();
+        }
+    }
+}
+
+void ThreadPool::RunTasks() {
+    for (size_t index = next_task_++; index < task_count_; index = next_task_++) {
+        try {
+            (*task_)(index);
+        } catch (...) {
+            std::lock_guard lock(mutex_);
+            if (!error_) {
+                error_ = std::current_exception();
+            }
+        }
+    }
+}
+
+ThreadPool& DefaultThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+}  // namespace parallel
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace parallel {
+
+// A fixed set of worker threads that executes index-parallel loops.
+// ParallelFor must not be called from inside one of its own tasks.
+class ThreadPool {
+public:
+    // thread_count counts the calling thread too, so 1 means "run everything inline"
+    // and 0 means "one thread per hardware core".
+    explicit ThreadPool(size_t thread_count = 0);
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool();
+
+    size_t GetThreadCount() const;
+
+    // Calls task(index) for every index in [0, task_count) and returns when all calls are done.
+    // The first exception thrown by a task is rethrown here.
+    void ParallelFor(size_t task_count, const std::function<void(size_t)>& task);
+
+private:
+    void WorkerLoop();
+    void RunTasks();
+
+private:
+    std::vector<std::thread> workers_;
+
+    std::mutex call_mutex_;
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+
+    const std::function<void(size_t)>* task_ = nullptr;
+    size_t task_count_ = 0;
+    std::atomic<size_t> next_task_{0};
+    size_t busy_workers_ = 0;
+    uint64_t generation_ = 0;
+    bool stopping_ = false;
+    std::exception_ptr error_;
+};
+
+// Pool shared by the catalogue and the routing code, sized to the number of hardware cores.
+ThreadPool& DefaultThreadPool();
+
+}  // namespace parallel
@@ -1,4 +1,5 @@
 #include "transport_catalogue.h"
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 #include <iostream>
@@ -8,115 +9,239 @@ using namespace std;
 namespace tc::catalogue {
 
 void TransportCatalogue::AddStop(const string& name, const geo::Coordinates& coordinates) {
-    domain::Stop stop;
-    stop.name = name;
-    stop.coordinates = coordinates;
-    auto& new_stop = stops_.emplace_back(std::move(stop));
-    stops_map_[new_stop.name] = &new_stop;
+    if (IsFrozen()) {
+        throw std::logic_error("Cannot add a stop to a frozen catalogue");
+    }
+    const auto& new_name = stop_names_.emplace_back(name);
+    stop_latitudes_.push_back(coordinates.lat);
+    stop_longitudes_.push_back(coordinates.lng);
+    stop_ids_[new_name] = static_cast<StopId>(stop_names_.size() - 1);
 }
 
 void TransportCatalogue::AddBus(const string& name, const vector<string_view> &stops, bool is_roundtrip) {
-    domain::Bus bus;
-    bus.name = name;
-    bus.is_roundtrip = is_roundtrip;
-    auto &new_bus = buses_.emplace_back(std::move(bus));
-    buses_map_[new_bus.name] = &new_bus;
+    if (IsFrozen()) {
+        throw std::logic_error("Cannot add a bus to a frozen catalogue");
+    }
+    const auto& new_name = bus_names_.emplace_back(name);
+    bus_roundtrips_.push_back(is_roundtrip);
+    bus_ids_[new_name] = static_cast<BusId>(bus_names_.size() - 1);
 
-    new_bus.stops.reserve(stops.size());
+    bus_stops_.reserve(bus_stops_.size() + stops.size());
     for (auto stop_name: stops) {
-        assert(stops_map_.count(stop_name));
-        auto *stop = stops_map_[stop_name];
-        stop->buses.emplace(&new_bus);
-        new_bus.stops.emplace_back(stop);
+        assert(stop_ids_.count(stop_name));
+        bus_stops_.push_back(stop_ids_.at(stop_name));
     }
+    bus_stop_offsets_.push_back(bus_stops_.size());
 }
 
 void TransportCatalogue::SetDistance(std::string_view first_stop_name, std::string_view second_stop_name, double distance)
 {
-    auto* first_stop = stops_map_.count(first_stop_name) ? stops_map_.at(first_stop_name) : nullptr;
+    if (IsFrozen()) {
+        throw std::logic_error("Cannot add a distance to a frozen catalogue");
+    }
+    auto first_stop = FindStop(first_stop_name);
     assert(first_stop);
-    auto* second_stop = stops_map_.count(second_stop_name) ? stops_map_.at(second_stop_name) : nullptr;
+    auto second_stop = FindStop(second_stop_name);
     assert(second_stop);
-    stops_distances_.emplace(std::pair{first_stop, second_stop}, distance);
+    stops_distances_.Set(*first_stop, *second_stop, distance);
+}
+
+void TransportCatalogue::Freeze(parallel::ThreadPool& thread_pool) {
+    if (IsFrozen()) {
+        return;
+    }
+    const size_t stop_count = stop_names_.size();
+    const size_t bus_count = bus_names_.size();
+
+    // every stop lists a bus once, however many times the bus passes it
+    std::vector<BusId> last_buses(stop_count, static_cast<BusId>(-1));
+    stop_bus_offsets_.assign(stop_count + 1, 0);
+    for (BusId bus_id = 0; bus_id < bus_count; ++bus_id) {
+        for (size_t i = bus_stop_offsets_[bus_id]; i < bus_stop_offsets_[bus_id + 1]; ++i) {
+            const StopId stop_id = bus_stops_[i];
+            if (last_buses[stop_id] != bus_id) {
+                last_buses[stop_id] = bus_id;
+                ++stop_bus_offsets_[stop_id + 1];
+            }
+        }
+    }
+    for (StopId stop_id = 0; stop_id < stop_count; ++stop_id) {
+        stop_bus_offsets_[stop_id + 1] += stop_bus_offsets_[stop_id];
+    }
+
+    stop_buses_.resize(stop_bus_offsets_.back());
+    std::vector<size_t> positions(stop_bus_offsets_.begin(), stop_bus_offsets_.end() - 1);
+    std::fill(last_buses.begin(), last_buses.end(), static_cast<BusId>(-1));
+    for (BusId bus_id = 0; bus_id < bus_count; ++bus_id) {
+        for (size_t i = bus_stop_offsets_[bus_id]; i < bus_stop_offsets_[bus_id + 1]; ++i) {
+            const StopId stop_id = bus_stops_[i];
+            if (last_buses[stop_id] != bus_id) {
+                last_buses[stop_id] = bus_id;
+                stop_buses_[positions[stop_id]++] = bus_id;
+            }
+        }
+    }
+
+    bus_infos_.resize(bus_count);
+    thread_pool.ParallelFor(bus_count, [this](size_t bus_id) {
+        bus_infos_[bus_id] = ComputeBusInfo(static_cast<BusId>(bus_id));
+    });
+
+    stop_grid_ = StopGrid(stop_latitudes_, stop_longitudes_);
+}
+
+bool TransportCatalogue::IsFrozen() const {
+    return !stop_bus_offsets_.empty();
+}
+
+void TransportCatalogue::CheckFrozen() const {
+    if (!IsFrozen()) {
+        throw std::logic_error("The catalogue should be frozen first");
+    }
 }
 
 std::optional<BusInfo> TransportCatalogue::GetBusInfo(string_view bus_name) const {
-    if (buses_map_.count(bus_name) == 0) {
+    const auto bus_id = FindBus(bus_name);
+    if (!bus_id) {
         return {};
     }
-    auto* cur_bus = buses_map_.at(bus_name);
-    assert(cur_bus);
+    return IsFrozen() ? bus_infos_[*bus_id] : ComputeBusInfo(*bus_id);
+}
+
+BusInfo TransportCatalogue::ComputeBusInfo(BusId bus_id) const {
+    const StopId* stops_begin = bus_stops_.data() + bus_stop_offsets_[bus_id];
+    const StopId* stops_end = bus_stops_.data() + bus_stop_offsets_[bus_id + 1];
+
     BusInfo bus_info;
-    bus_info.name = cur_bus->name;
-    bus_info.stops_count = cur_bus->stops.size();
-    bus_info.unique_stops_count = std::unordered_set<const domain::Stop *>(cur_bus->stops.begin(), cur_bus->stops.end()).size();
+    bus_info.name = bus_names_[bus_id];
+    bus_info.stops_count = stops_end - stops_begin;
+    std::vector<StopId> unique_stops(stops_begin, stops_end);
+    std::sort(unique_stops.begin(), unique_stops.end());
+    bus_info.unique_stops_count = std::unique(unique_stops.begin(), unique_stops.end()) - unique_stops.begin();
 
     double route_len_geo = 0;
 
-    auto stops_begin = cur_bus->stops.begin();
-    auto stops_end = cur_bus->stops.end();
-    for (auto stops_it = stops_begin; stops_it != stops_end; ++stops_it) {
-        if(stops_it == stops_begin) {
+    for (const StopId* stop_it = stops_begin; stop_it != stops_end; ++stop_it) {
+        if(stop_it == stops_begin) {
             continue;
         }
-        auto* first_stop = *std::prev(stops_it);
-        assert(first_stop);
-        auto* second_stop = *stops_it;
-        assert(second_stop);
-        auto dist_geo = tc::geo::ComputeDistance(first_stop->coordinates, second_stop->coordinates);
+        const StopId first_stop = *(stop_it - 1);
+        const StopId second_stop = *stop_it;
+        auto dist_geo = tc::geo::ComputeDistance({stop_latitudes_[first_stop], stop_longitudes_[first_stop]},
+                                                 {stop_latitudes_[second_stop], stop_longitudes_[second_stop]});
         route_len_geo += dist_geo;
-
-        if(stops_distances_.count(pair{first_stop, second_stop})) {
-            bus_info.route_length += stops_distances_.at(pair{first_stop, second_stop});
-        } else if(stops_distances_.count(pair{second_stop, first_stop})) {
-            bus_info.route_length += stops_distances_.at(pair{second_stop, first_stop});
-        } else {
-            bus_info.route_length += dist_geo;
-        }
+        bus_info.route_length += GetDistance(first_stop, second_stop).value_or(dist_geo);
     }
 
-    assert(route_len_geo != 0);
-    bus_info.curvature = bus_info.route_length / route_len_geo;
+    // Freeze computes every bus, including ones too short to have a curvature
+    if (route_len_geo != 0) {
+        bus_info.curvature = bus_info.route_length / route_len_geo;
+    }
     return bus_info;
 }
 
 std::optional<StopInfo> TransportCatalogue::GetStopInfo(string_view stop_name) const {
-    if (stops_map_.count(stop_name) == 0) {
+    const auto stop_id = FindStop(stop_name);
+    if (!stop_id) {
         return {};
     }
-    auto* cur_stop = stops_map_.at(stop_name);
-    assert(cur_stop);
 
     StopInfo stop_info;
-    stop_info.name = cur_stop->name;
-    for(const auto* bus: cur_stop->buses) {
-        stop_info.buses.emplace(bus->name);
+    stop_info.name = stop_names_[*stop_id];
+    if (IsFrozen()) {
+        for(size_t i = stop_bus_offsets_[*stop_id]; i < stop_bus_offsets_[*stop_id + 1]; ++i) {
+            stop_info.buses.emplace(bus_names_[stop_buses_[i]]);
+        }
+        return stop_info;
     }
 
+    // no stop -> buses index yet, every bus is scanned
+    for (BusId bus_id = 0; bus_id < bus_names_.size(); ++bus_id) {
+        const auto stops_begin = bus_stops_.begin() + bus_stop_offsets_[bus_id];
+        const auto stops_end = bus_stops_.begin() + bus_stop_offsets_[bus_id + 1];
+        if (std::find(stops_begin, stops_end, *stop_id) != stops_end) {
+            stop_info.buses.emplace(bus_names_[bus_id]);
+        }
+    }
     return stop_info;
 }
 
-const TransportCatalogue::Stops& TransportCatalogue::GetStops() const {
-    return stops_;
+std::optional<TransportCatalogue::StopId> TransportCatalogue::FindStop(std::string_view stop_name) const {
+    if (auto stop_it = stop_ids_.find(stop_name); stop_it != stop_ids_.end()) {
+        return stop_it->second;
+    }
+    return std::nullopt;
+}
+
+std::optional<TransportCatalogue::BusId> TransportCatalogue::FindBus(std::string_view bus_name) const {
+    if (auto bus_it = bus_ids_.find(bus_name); bus_it != bus_ids_.end()) {
+        return bus_it->second;
+    }
+    return std::nullopt;
+}
+
+size_t TransportCatalogue::GetStopCount() const {
+    return stop_names_.size();
+}
+
+size_t TransportCatalogue::GetBusCount() const {
+    return bus_names_.size();
+}
+
+TransportCatalogue::Stop TransportCatalogue::GetStop(StopId stop_id) const {
+    const BusId* buses = stop_buses_.data();
+    const size_t buses_begin = IsFrozen() ? stop_bus_offsets_[stop_id] : 0;
+    const size_t buses_end = IsFrozen() ? stop_bus_offsets_[stop_id + 1] : 0;
+    return {stop_id, stop_names_[stop_id], {stop_latitudes_[stop_id], stop_longitudes_[stop_id]},
+            {buses + buses_begin, buses + buses_end}};
+}
+
+TransportCatalogue::Bus TransportCatalogue::GetBus(BusId bus_id) const {
+    const StopId* stops = bus_stops_.data();
+    return {bus_id, bus_names_[bus_id], bus_roundtrips_[bus_id],
+            {ViewIterator<Stop>(*this, stops + bus_stop_offsets_[bus_id]),
+             ViewIterator<Stop>(*this, stops + bus_stop_offsets_[bus_id + 1])}};
 }
 
-const TransportCatalogue::Buses& TransportCatalogue::GetBuses() const {
-    return buses_;
+TransportCatalogue::StopRange TransportCatalogue::GetStops() const {
+    return {ViewIterator<Stop>(*this, StopId{0}), ViewIterator<Stop>(*this, static_cast<StopId>(stop_names_.size()))};
+}
+
+std::vector<TransportCatalogue::NearbyStop> TransportCatalogue::FindNearestStops(geo::Coordinates coordinates,
+                                                                                size_t count) const {
+    CheckFrozen();
+    std::vector<NearbyStop> result;
+    for (const auto& neighbour : stop_grid_.FindNearest(coordinates, count)) {
+        result.push_back({GetStop(neighbour.id), neighbour.distance});
+    }
+    return result;
+}
+
+std::vector<TransportCatalogue::Stop> TransportCatalogue::GetStopsInBox(geo::Coordinates min,
+                                                                        geo::Coordinates max) const {
+    CheckFrozen();
+    std::vector<Stop> result;
+    for (const StopId stop_id : stop_grid_.FindInBox(min, max)) {
+        result.push_back(GetStop(stop_id));
+    }
+    return result;
+}
+
+TransportCatalogue::BusRange TransportCatalogue::GetBuses() const {
+    return {ViewIterator<Bus>(*this, BusId{0}), ViewIterator<Bus>(*this, static_cast<BusId>(bus_names_.size()))};
 }
 
 std::optional<double> TransportCatalogue::GetDistance(std::string_view first_stop_name, std::string_view second_stop_name) const {
-    if(!stops_map_.count(first_stop_name) || !stops_map_.count(second_stop_name)){
+    const auto first_stop = FindStop(first_stop_name);
+    const auto second_stop = FindStop(second_stop_name);
+    if(!first_stop || !second_stop){
         return std::nullopt;
     }
-    const auto* first_stop = stops_map_.at(first_stop_name);
-    const auto* second_stop = stops_map_.at(second_stop_name);
-    if(!stops_distances_.count({first_stop, second_stop})) {
-        if(!stops_distances_.count({second_stop, first_stop})) {
-            return std::nullopt;
-        }
-        return stops_distances_.at({second_stop, first_stop});
-    }
-    return stops_distances_.at({first_stop, second_stop});
+    return GetDistance(*first_stop, *second_stop);
 }
 
-}
\ No newline at end of file
+std::optional<double> TransportCatalogue::GetDistance(StopId first_stop, StopId second_stop) const {
+    return stops_distances_.Get(first_stop, second_stop);
+}
+
+}
@@ -1,16 +1,22 @@
 #pragma once
+#include <cstdint>
 #include <deque>
+#include <iterator>
 #include <string>
 #include <string_view>
 #include <unordered_map>
-#include <unordered_set>
 #include <vector>
 #include <utility>
 #include <set>
 #include <optional>
+#include <type_traits>
 
+#include "distance_table.h"
 #include "domain.h"
 #include "geo.h"
+#include "ranges.h"
+#include "stop_grid.h"
+#include "thread_pool.h"
 
 namespace tc::catalogue {
 
@@ -27,11 +33,100 @@ struct BusInfo {
     double curvature = 0;
 };
 
+// Stops and buses get dense ids in the order they are added and are stored column by column:
+// coordinates in separate latitude and longitude arrays, the stops of all buses in one id array
+// with per-bus offsets. Freeze adds the buses of every stop in compressed sparse row form and
+// a grid over the stop coordinates; after it nothing can be added and the statistics of every
+// bus are computed once. Stops and buses are read as views assembled from these arrays.
 class TransportCatalogue {
-
 public:
-    using Stops = std::deque<domain::Stop>;
-    using Buses = std::deque<domain::Bus>;
+    using StopId = domain::StopId;
+    using BusId = domain::BusId;
+
+    // Walks stops or buses along an id array or, without one, over consecutive ids,
+    // and reads the view of each from the catalogue.
+    template <typename View>
+    class ViewIterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = View;
+        using difference_type = std::ptrdiff_t;
+        using reference = View;
+
+        // what operator-> points to: views are assembled on the fly, so it keeps one
+        struct Pointer {
+            View view;
+
+            const View* operator->() const {
+                return &view;
+            }
+        };
+        using pointer = Pointer;
+
+        ViewIterator(const TransportCatalogue& catalogue, const uint32_t* id_it)
+            : catalogue_(&catalogue)
+            , id_it_(id_it) {
+        }
+        ViewIterator(const TransportCatalogue& catalogue, uint32_t id)
+            : catalogue_(&catalogue)
+            , id_(id) {
+        }
+
+        View operator*() const;
+        Pointer operator->() const {
+            return {**this};
+        }
+        ViewIterator& operator++() {
+            if (id_it_) {
+                ++id_it_;
+            } else {
+                ++id_;
+            }
+            return *this;
+        }
+        ViewIterator operator++(int) {
+            auto prev = *this;
+            ++*this;
+            return prev;
+        }
+        bool operator==(const ViewIterator& other) const {
+            return id_it_ == other.id_it_ && id_ == other.id_;
+        }
+        bool operator!=(const ViewIterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const TransportCatalogue* catalogue_;
+        const uint32_t* id_it_ = nullptr;
+        uint32_t id_ = 0;
+    };
+
+    struct Stop;
+    struct Bus;
+    using StopRange = ranges::Range<ViewIterator<Stop>>;
+    using BusRange = ranges::Range<ViewIterator<Bus>>;
+
+    struct Stop {
+        StopId id;
+        std::string_view name;
+        geo::Coordinates coordinates;
+        // ids of the buses passing the stop, ascending; empty until Freeze
+        ranges::Range<const BusId*> buses;
+    };
+
+    struct Bus {
+        BusId id;
+        std::string_view name;
+        bool is_roundtrip;
+        StopRange stops;
+    };
+
+    struct NearbyStop {
+        Stop stop;
+        // as the crow flies, in meters
+        double distance;
+    };
 
 public:
     TransportCatalogue() = default;
@@ -44,23 +139,75 @@ public:
 
     void SetDistance(std::string_view first_stop_name, std::string_view second_stop_name, double distance);
 
+    // Builds the buses of every stop, the statistics of every bus and the grid of the stops.
+    // Stops, buses and distances cannot be added afterwards.
+    void Freeze(parallel::ThreadPool& thread_pool = parallel::DefaultThreadPool());
+    bool IsFrozen() const;
+
+    // A lookup once the catalogue is frozen, computed on the spot before.
     std::optional<BusInfo> GetBusInfo(std::string_view bus_name) const;
 
+    // A lookup once the catalogue is frozen, a scan of all the buses before.
     std::optional<StopInfo> GetStopInfo(std::string_view stop_name) const;
 
-    const Stops& GetStops() const;
+    std::optional<StopId> FindStop(std::string_view stop_name) const;
+    std::optional<BusId> FindBus(std::string_view bus_name) const;
+
+    size_t GetStopCount() const;
+    size_t GetBusCount() const;
+    Stop GetStop(StopId stop_id) const;
+    Bus GetBus(BusId bus_id) const;
+
+    // All of them, by id.
+    StopRange GetStops() const;
+
+    // Need a frozen catalogue. The `count` stops closest to the point, nearest first.
+    std::vector<NearbyStop> FindNearestStops(geo::Coordinates coordinates, size_t count) const;
+    // The stops with min.lat <= lat <= max.lat and min.lng <= lng <= max.lng, by id.
+    std::vector<Stop> GetStopsInBox(geo::Coordinates min, geo::Coordinates max) const;
 
-    const Buses& GetBuses() const;
+    BusRange GetBuses() const;
 
     std::optional<double> GetDistance(std::string_view first_stop_name, std::string_view second_stop_name) const;
+    // The road distance from the first stop to the second or, if only that is known, back.
+    std::optional<double> GetDistance(StopId first_stop, StopId second_stop) const;
 
 private:
-    Stops stops_;
-    Buses buses_;
-    std::unordered_map<std::string_view, domain::Bus *> buses_map_;
-    std::unordered_map<std::string_view, domain::Stop *> stops_map_;
-    std::unordered_map<std::pair<const domain::Stop*, const domain::Stop*>, double,
-                       domain::OrderedPairHasher<const domain::Stop*, const domain::Stop*>> stops_distances_;
+    void CheckFrozen() const;
+    BusInfo ComputeBusInfo(BusId bus_id) const;
+
+    // names are referenced by the maps below and by the views, so they must not move
+    std::deque<std::string> stop_names_;
+    std::vector<double> stop_latitudes_;
+    std::vector<double> stop_longitudes_;
+    std::unordered_map<std::string_view, StopId> stop_ids_;
+
+    std::deque<std::string> bus_names_;
+    std::vector<bool> bus_roundtrips_;
+    // the stops of bus b are bus_stops_[bus_stop_offsets_[b], bus_stop_offsets_[b + 1])
+    std::vector<StopId> bus_stops_;
+    std::vector<size_t> bus_stop_offsets_ = {0};
+    std::unordered_map<std::string_view, BusId> bus_ids_;
+
+    // filled by Freeze: the buses of stop s are stop_buses_[stop_bus_offsets_[s], stop_bus_offsets_[s + 1])
+    std::vector<BusId> stop_buses_;
+    std::vector<size_t> stop_bus_offsets_;
+    // filled by Freeze, by bus id
+    std::vector<BusInfo> bus_infos_;
+    // filled by Freeze
+    StopGrid stop_grid_;
+
+    DistanceTable stops_distances_;
 };
 
-}
\ No newline at end of file
+template <typename View>
+View TransportCatalogue::ViewIterator<View>::operator*() const {
+    const uint32_t id = id_it_ ? *id_it_ : id_;
+    if constexpr (std::is_same_v<View, Stop>) {
+        return catalogue_->GetStop(id);
+    } else {
+        return catalogue_->GetBus(id);
+    }
+}
+
+}
@@ -1,8 +1,56 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <exception>
+#include <iterator>
+#include <fstream>
+#include <type_traits>
+#include <unordered_map>
 #include <utility>
 #include "transport_router.h"
 
 namespace tc::routing {
 
+namespace {
+
+constexpr char INDEX_MAGIC[8] = {'T', 'C', 'R', 'I', 'D', 'X', 0, 0};
+// bumped whenever the layout of the index file changes
+constexpr uint32_t INDEX_VERSION = 3;
+// reads back differently on a machine with another byte order
+constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+// Position of a cell of a 2^16 x 2^16 grid along the Hilbert curve filling it.
+uint64_t GetHilbertIndex(uint32_t x, uint32_t y) {
+    constexpr uint32_t SIDE = 1u << 16;
+    uint64_t index = 0;
+    for(uint32_t half = SIDE / 2; half > 0; half /= 2) {
+        const uint32_t right = (x & half) ? 1 : 0;
+        const uint32_t top = (y & half) ? 1 : 0;
+        index += uint64_t(half) * half * ((3 * right) ^ top);
+        // rotate the quadrant so that the curve inside it starts and ends where it should
+        if(top == 0) {
+            if(right == 1) {
+                x = SIDE - 1 - x;
+                y = SIDE - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
+}
+
+struct IndexHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    // the edges are stored as they are, so the file only fits a build with the same EdgeWeight
+    uint32_t edge_weight_size;
+    uint32_t edge_weight_is_integral;
+    uint64_t fingerprint;
+};
+
+}
+
 TransportRouter::TransportRouter(TransportRouter::RouterSettings settings) : settings_(std::move(settings)) {
 
 }
@@ -12,46 +60,1011 @@ TransportRouter& TransportRouter::SetSettings(RouterSettings settings) {
     return *this;
 }
 
-std::optional<TransportRouter::Route> TransportRouter::GetRoute(std::string_view from, std::string_view to) const {
-    std::optional<TransportRouter::Route> result_route;
-    if(!router_) {
-        return result_route;
+void TransportRouter::BuildGraph(const std::vector<BusRoute>& bus_routes) {
+    bus_names_.clear();
+    for(const auto& bus_route: bus_routes) {
+        bus_names_.push_back(bus_route.name);
+    }
+    edge_infos_.clear();
+    ride_vertex_stops_.clear();
+
+    switch(settings_.graph_model) {
+        case GraphModel::STOP_PAIRS:
+            BuildStopPairsGraph(bus_routes);
+            break;
+        case GraphModel::RIDES:
+            BuildRidesGraph(bus_routes);
+            break;
+    }
+
+    const auto new_edge_ids = graph_->Freeze();
+    std::vector<EdgeInfo> edge_infos(edge_infos_.size());
+    for(graph::EdgeId edge_id = 0; edge_id < edge_infos_.size(); ++edge_id) {
+        edge_infos[new_edge_ids[edge_id]] = edge_infos_[edge_id];
+    }
+    edge_infos_ = std::move(edge_infos);
+    components_ = graph::ConnectedComponents<EdgeWeight>(*graph_);
+}
+
+void TransportRouter::BuildRouter() {
+    switch(backend_) {
+        case RouterBackend::ALL_PAIRS:
+            router_.emplace<graph::Router<EdgeWeight>>(*graph_);
+            break;
+        case RouterBackend::DIJKSTRA:
+            router_.emplace<graph::DijkstraRouter<EdgeWeight>>(*graph_);
+            break;
+        case RouterBackend::BIDIRECTIONAL_DIJKSTRA:
+            router_.emplace<graph::DijkstraRouter<EdgeWeight>>(
+                    *graph_, graph::DijkstraRouter<EdgeWeight>::SearchMode::BIDIRECTIONAL);
+            break;
+        case RouterBackend::A_STAR:
+            router_.emplace<graph::DijkstraRouter<EdgeWeight>>(
+                    *graph_, graph::DijkstraRouter<EdgeWeight>::SearchMode::A_STAR,
+                    [this](graph::VertexId from, graph::VertexId to) {
+                        return GetTimeLowerBound(from, to);
+                    });
+            break;
+        case RouterBackend::CONTRACTION_HIERARCHIES:
+            router_.emplace<graph::ContractionHierarchy<EdgeWeight>>(*graph_);
+            break;
+        case RouterBackend::ALT:
+            landmarks_.emplace(*graph_, settings_.landmark_count);
+            EmplaceLandmarkRouter();
+            break;
+        case RouterBackend::HUB_LABELS:
+            router_.emplace<graph::HubLabels<EdgeWeight>>(*graph_);
+            break;
+        case RouterBackend::AUTO:
+            throw std::logic_error("RouterBackend::AUTO should be resolved before building the router");
+    }
+}
+
+void TransportRouter::EmplaceLandmarkRouter() {
+    router_.emplace<graph::DijkstraRouter<EdgeWeight>>(
+            *graph_, graph::DijkstraRouter<EdgeWeight>::SearchMode::A_STAR,
+            [this](graph::VertexId from, graph::VertexId to) {
+                return landmarks_->GetLowerBound(from, to);
+            });
+}
+
+std::vector<TransportRouter::BusRoute> TransportRouter::AssignStops() {
+    stop_names_.clear();
+    nodes_map_.clear();
+    stop_coordinates_.clear();
+    max_geo_velocity_ = 0;
+
+    std::vector<BusRoute> bus_routes;
+    bus_routes.reserve(bus_lines_.size());
+    for(const auto& bus_line: bus_lines_) {
+        auto& bus_route = bus_routes.emplace_back();
+        bus_route.name = bus_line.name;
+        bus_route.stops.reserve(bus_line.stops.size());
+        for(size_t i = 0; i < bus_line.stops.size(); ++i) {
+            auto [node_it, inserted] = nodes_map_.emplace(bus_line.stops[i], stop_names_.size());
+            if(inserted) {
+                stop_names_.emplace_back(bus_line.stops[i]);
+                stop_coordinates_.emplace_back(bus_line.stop_coordinates[i]);
+            }
+            bus_route.stops.emplace_back(node_it->second);
+        }
+        bus_route.times_from_first_stop = bus_line.times_from_first_stop;
+        max_geo_velocity_ = std::max(max_geo_velocity_, bus_line.max_geo_velocity);
+    }
+    if(settings_.stop_order == StopOrder::HILBERT_CURVE) {
+        SortStopsAlongHilbertCurve(bus_routes);
+    }
+    return bus_routes;
+}
+
+void TransportRouter::SortStopsAlongHilbertCurve(std::vector<BusRoute>& bus_routes) {
+    const size_t stop_count = stop_names_.size();
+    if(stop_count == 0) {
+        return;
+    }
+    const auto [min_lat, max_lat] = std::minmax_element(stop_coordinates_.begin(), stop_coordinates_.end(),
+            [](const geo::Coordinates& lhs, const geo::Coordinates& rhs) { return lhs.lat < rhs.lat; });
+    const auto [min_lng, max_lng] = std::minmax_element(stop_coordinates_.begin(), stop_coordinates_.end(),
+            [](const geo::Coordinates& lhs, const geo::Coordinates& rhs) { return lhs.lng < rhs.lng; });
+    // the bounding box, stretched to the grid along each axis
+    const auto to_cell = [](double value, double min, double max) {
+        return max > min ? static_cast<uint32_t>((value - min) / (max - min) * 65535) : 0u;
+    };
+
+    std::vector<std::pair<uint64_t, size_t>> keys(stop_count);
+    for(size_t id = 0; id < stop_count; ++id) {
+        const auto& coordinates = stop_coordinates_[id];
+        keys[id] = {GetHilbertIndex(to_cell(coordinates.lng, min_lng->lng, max_lng->lng),
+                                    to_cell(coordinates.lat, min_lat->lat, max_lat->lat)), id};
+    }
+    // ties keep the order of appearance
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<size_t> new_ids(stop_count);
+    std::vector<std::string_view> stop_names(stop_count);
+    std::vector<geo::Coordinates> stop_coordinates(stop_count);
+    for(size_t new_id = 0; new_id < stop_count; ++new_id) {
+        const size_t old_id = keys[new_id].second;
+        new_ids[old_id] = new_id;
+        stop_names[new_id] = stop_names_[old_id];
+        stop_coordinates[new_id] = stop_coordinates_[old_id];
+    }
+    stop_names_ = std::move(stop_names);
+    stop_coordinates_ = std::move(stop_coordinates);
+    for(auto& [name, id]: nodes_map_) {
+        id = new_ids[id];
+    }
+    for(auto& bus_route: bus_routes) {
+        for(auto& stop: bus_route.stops) {
+            stop = new_ids[stop];
+        }
+    }
+}
+
+TransportRouter& TransportRouter::RemoveBus(std::string_view name) {
+    UpdateBusLine(name, std::nullopt);
+    return *this;
+}
+
+// The graph and the route metadata are rebuilt from bus_lines_ exactly as SetData would build
+// them, which takes linear time. The routing index is what is expensive to rebuild: the
+// all-pairs table is updated in place through the old -> new vertex and edge id mappings,
+// every other backend, or a table AUTO no longer stands for, is rebuilt over the new graph.
+void TransportRouter::UpdateBusLine(std::string_view name, std::optional<BusLine> line) {
+    if(!has_bus_lines_) {
+        throw std::logic_error("A router loaded from an index file has no buses to update");
+    }
+
+    auto line_it = std::find_if(bus_lines_.begin(), bus_lines_.end(), [name](const BusLine& bus_line) {
+        return bus_line.name == name;
+    });
+    if(line_it == bus_lines_.end() && !line) {
+        return;
+    }
+
+    const auto old_stop_names = stop_names_;
+    std::vector<std::pair<std::string_view, size_t>> old_bus_sizes;
+    for(const auto& bus_line: bus_lines_) {
+        old_bus_sizes.emplace_back(bus_line.name, bus_line.stops.size());
+    }
+
+    if(line_it == bus_lines_.end()) {
+        bus_lines_.push_back(std::move(*line));
+    } else if(line) {
+        *line_it = std::move(*line);
+    } else {
+        bus_lines_.erase(line_it);
+    }
+
+    if(!graph_) {
+        Reset();
+        const auto bus_routes = AssignStops();
+        ResolveBackend(bus_routes);
+        BuildGraph(bus_routes);
+        BuildRouter();
+        return;
+    }
+
+    auto old_graph = std::move(*graph_);
+    const auto old_backend = backend_;
+    const auto bus_routes = AssignStops();
+    ResolveBackend(bus_routes);
+    BuildGraph(bus_routes);
+
+    using Router = graph::Router<EdgeWeight>;
+    std::vector<graph::VertexId> new_vertex_ids(old_graph.GetVertexCount(), Router::REMOVED_ID);
+    for(size_t old_stop = 0; old_stop < old_stop_names.size(); ++old_stop) {
+        auto node_it = nodes_map_.find(old_stop_names[old_stop]);
+        if(node_it == nodes_map_.end()) {
+            continue;
+        }
+        if(settings_.graph_model == GraphModel::STOP_PAIRS) {
+            new_vertex_ids[old_stop * 2] = node_it->second * 2;
+            new_vertex_ids[old_stop * 2 + 1] = node_it->second * 2 + 1;
+        } else {
+            new_vertex_ids[old_stop] = node_it->second;
+        }
+    }
+    if(settings_.graph_model == GraphModel::RIDES) {
+        // ride vertices of the untouched buses keep their positions within the bus
+        std::unordered_map<std::string_view, graph::VertexId> first_ride_vertices;
+        graph::VertexId ride_vertex = stop_names_.size();
+        for(const auto& bus_line: bus_lines_) {
+            first_ride_vertices.emplace(bus_line.name, ride_vertex);
+            ride_vertex += bus_line.stops.size();
+        }
+        graph::VertexId old_ride_vertex = old_stop_names.size();
+        for(const auto& [bus_name, size]: old_bus_sizes) {
+            if(bus_name != name) {
+                const auto first_ride_vertex = first_ride_vertices.at(bus_name);
+                for(size_t i = 0; i < size; ++i) {
+                    new_vertex_ids[old_ride_vertex + i] = first_ride_vertex + i;
+                }
+            }
+            old_ride_vertex += size;
+        }
+    }
+
+    // every pair of vertices is joined by one edge at most
+    std::unordered_map<std::pair<graph::VertexId, graph::VertexId>, graph::EdgeId,
+            domain::OrderedPairHasher<graph::VertexId, graph::VertexId>> new_edges;
+    for(graph::EdgeId edge_id = 0; edge_id < graph_->GetEdgeCount(); ++edge_id) {
+        const auto& edge = graph_->GetEdge(edge_id);
+        new_edges.emplace(std::pair{edge.from, edge.to}, edge_id);
+    }
+    std::vector<graph::EdgeId> new_edge_ids(old_graph.GetEdgeCount(), Router::REMOVED_ID);
+    for(graph::EdgeId edge_id = 0; edge_id < old_graph.GetEdgeCount(); ++edge_id) {
+        const auto& edge = old_graph.GetEdge(edge_id);
+        const auto from = new_vertex_ids[edge.from];
+        const auto to = new_vertex_ids[edge.to];
+        if(from == Router::REMOVED_ID || to == Router::REMOVED_ID) {
+            continue;
+        }
+        if(auto new_edge_it = new_edges.find({from, to}); new_edge_it != new_edges.end()) {
+            new_edge_ids[edge_id] = new_edge_it->second;
+        }
+    }
+
+    auto* router = backend_ == old_backend ? std::get_if<Router>(&router_) : nullptr;
+    if(router) {
+        router->Update(old_graph, new_vertex_ids, new_edge_ids);
+    } else {
+        BuildRouter();
+    }
+    // nothing points into a loaded index file any more
+    mapped_index_.reset();
+}
+
+// The index file is only a cache: a file that cannot be read or does not fit counts as a miss,
+// and a file that cannot be written is left as it is.
+void TransportRouter::BuildIndex(std::vector<BusRoute> bus_routes) {
+    ResolveBackend(bus_routes);
+    if(settings_.index_file.empty()) {
+        BuildGraph(bus_routes);
+        BuildRouter();
+        return;
+    }
+
+    const auto fingerprint = ComputeFingerprint(bus_routes);
+    const auto settings = settings_;
+    const auto backend = backend_;
+    try {
+        if(std::ifstream(settings_.index_file) && LoadIndex(settings_.index_file, fingerprint)) {
+            return;
+        }
+    } catch(const std::exception&) {
+        // LoadIndex may have replaced the settings and reset the stops before failing
+        Reset();
+        settings_ = settings;
+        backend_ = backend;
+        bus_routes = AssignStops();
+    }
+    BuildGraph(bus_routes);
+    BuildRouter();
+    try {
+        SaveIndex(settings_.index_file, fingerprint);
+    } catch(const std::exception&) {
+        // the router is complete, only the next run builds the index again
+    }
+}
+
+void TransportRouter::ResolveBackend(const std::vector<BusRoute>& bus_routes) {
+    backend_ = settings_.backend == RouterBackend::AUTO ? ChooseBackend(bus_routes) : settings_.backend;
+}
+
+// The graph comes first in every estimate: edges and their metadata plus the CSR offsets.
+// The STOP_PAIRS edge count is an upper bound, pairs shared by several buses are counted for each.
+// A contraction hierarchy is taken to add about as many shortcuts as there are edges, and every
+// hierarchy edge is stored once more as an arc at each end.
+RouterBackend TransportRouter::ChooseBackend(const std::vector<BusRoute>& bus_routes) const {
+    const size_t stop_count = stop_names_.size();
+    size_t vertex_count = 0;
+    size_t edge_count = 0;
+    switch(settings_.graph_model) {
+        case GraphModel::STOP_PAIRS:
+            vertex_count = stop_count * 2;
+            edge_count = stop_count;
+            for(const auto& bus_route: bus_routes) {
+                edge_count += bus_route.stops.size() * (bus_route.stops.size() - 1) / 2;
+            }
+            break;
+        case GraphModel::RIDES:
+            vertex_count = stop_count;
+            for(const auto& bus_route: bus_routes) {
+                vertex_count += bus_route.stops.size();
+                edge_count += bus_route.stops.empty() ? 0 : (bus_route.stops.size() - 1) * 3;
+            }
+            break;
+    }
+
+    using Hierarchy = graph::ContractionHierarchy<EdgeWeight>;
+    const size_t graph_size = edge_count * (sizeof(graph::Edge<EdgeWeight>) + sizeof(EdgeInfo))
+                              + (vertex_count + 1) * sizeof(size_t);
+    const size_t table_size = graph::Router<EdgeWeight>::ComputeTableSize(vertex_count);
+    const size_t hierarchy_size = 2 * edge_count * (sizeof(Hierarchy::HierarchyEdge) + 2 * sizeof(Hierarchy::Arc))
+                                  + 2 * (vertex_count + 1) * sizeof(size_t);
+
+    if(graph_size + table_size <= settings_.memory_budget) {
+        return RouterBackend::ALL_PAIRS;
+    }
+    if(graph_size + hierarchy_size <= settings_.memory_budget) {
+        return RouterBackend::CONTRACTION_HIERARCHIES;
     }
+    return RouterBackend::DIJKSTRA;
+}
+
+// Covers everything the index is built from, in the order SetData saw it.
+uint64_t TransportRouter::ComputeFingerprint(const std::vector<BusRoute>& bus_routes) const {
+    serialization::Hasher hasher;
+    hasher.Add(INDEX_VERSION)
+          .Add(settings_.bus_velocity)
+          .Add(settings_.bus_wait_time)
+          .Add(backend_)
+          .Add(settings_.graph_model)
+          .Add(settings_.stop_order)
+          .Add(settings_.landmark_count)
+          .Add(stop_names_.size());
+    for(size_t id = 0; id < stop_names_.size(); ++id) {
+        hasher.Add(stop_names_[id]).Add(stop_coordinates_[id].lat).Add(stop_coordinates_[id].lng);
+    }
+    hasher.Add(bus_routes.size());
+    for(const auto& bus_route: bus_routes) {
+        hasher.Add(bus_route.name).Add(bus_route.stops.size());
+        for(size_t i = 0; i < bus_route.stops.size(); ++i) {
+            hasher.Add(bus_route.stops[i]).Add(bus_route.times_from_first_stop[i]);
+        }
+    }
+    return hasher.GetHash();
+}
+
+void TransportRouter::SaveIndex(const std::string& path) const {
+    SaveIndex(path, 0);
+}
+
+void TransportRouter::SaveIndex(const std::string& path, uint64_t fingerprint) const {
+    if(!graph_) {
+        throw std::logic_error("Nothing to save: the router has no data");
+    }
+
+    serialization::BinaryWriter writer(path);
+    IndexHeader header{};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+    header.version = INDEX_VERSION;
+    header.byte_order = BYTE_ORDER_MARK;
+    header.edge_weight_size = sizeof(EdgeWeight);
+    header.edge_weight_is_integral = std::is_integral_v<EdgeWeight>;
+    header.fingerprint = fingerprint;
+    writer.Write(header);
+
+    writer.Write(settings_.bus_velocity);
+    writer.Write(static_cast<int32_t>(settings_.bus_wait_time));
+    writer.Write(static_cast<uint32_t>(backend_));
+    writer.Write(static_cast<uint32_t>(settings_.graph_model));
+    writer.Write(max_geo_velocity_);
+
+    writer.WriteStrings(stop_names_);
+    writer.WriteArray(stop_coordinates_);
+
+    writer.WriteStrings(bus_names_);
+    writer.WriteArray(edge_infos_);
+    writer.WriteArray(ride_vertex_stops_);
 
+    std::vector<graph::Edge<EdgeWeight>> edges;
+    edges.reserve(graph_->GetEdgeCount());
+    for(graph::EdgeId edge_id = 0; edge_id < graph_->GetEdgeCount(); ++edge_id) {
+        edges.push_back(graph_->GetEdge(edge_id));
+    }
+    writer.Write(static_cast<uint64_t>(graph_->GetVertexCount()));
+    writer.WriteArray(edges);
+
+    if(const auto* router = std::get_if<graph::Router<EdgeWeight>>(&router_)) {
+        writer.WriteArray(router->GetTableData(), router->GetTableSize());
+    } else if(const auto* hierarchy = std::get_if<graph::ContractionHierarchy<EdgeWeight>>(&router_)) {
+        const auto index = hierarchy->GetIndex();
+        writer.WriteArray(index.edges);
+        writer.WriteArray(index.forward_offsets);
+        writer.WriteArray(index.forward_arcs);
+        writer.WriteArray(index.backward_offsets);
+        writer.WriteArray(index.backward_arcs);
+    } else if(const auto* hub_labels = std::get_if<graph::HubLabels<EdgeWeight>>(&router_)) {
+        const auto& index = hub_labels->GetIndex();
+        writer.WriteArray(index.hubs);
+        writer.WriteArray(index.forward_offsets);
+        writer.WriteArray(index.forward_entries);
+        writer.WriteArray(index.backward_offsets);
+        writer.WriteArray(index.backward_entries);
+    } else if(landmarks_) {
+        const auto& index = landmarks_->GetIndex();
+        writer.WriteArray(index.landmarks);
+        writer.WriteArray(index.from_landmarks);
+        writer.WriteArray(index.to_landmarks);
+    }
+
+    writer.Commit();
+}
+
+void TransportRouter::LoadIndex(const std::string& path) {
+    LoadIndex(path, std::nullopt);
+    bus_lines_.clear();
+    has_bus_lines_ = false;
+}
+
+// Only the names and the all-pairs table, the one part quadratic in the stop count, stay in the
+// mapping. The rest is far smaller and is copied, as the graph and the other backends keep their
+// arrays in vectors of their own.
+bool TransportRouter::LoadIndex(const std::string& path, std::optional<uint64_t> fingerprint) {
+    auto mapped_index = std::make_unique<serialization::MappedFile>(path);
+    serialization::BinaryReader reader(mapped_index->GetData(), mapped_index->GetSize());
+
+    const auto header = reader.Read<IndexHeader>();
+    const bool header_fits = std::memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) == 0
+                             && header.version == INDEX_VERSION && header.byte_order == BYTE_ORDER_MARK
+                             && header.edge_weight_size == sizeof(EdgeWeight)
+                             && header.edge_weight_is_integral == std::is_integral_v<EdgeWeight>;
+    if(fingerprint && (!header_fits || header.fingerprint != *fingerprint)) {
+        return false;
+    }
+    if(!header_fits) {
+        throw serialization::FormatError(path + " is not a transport router index of version "
+                                         + std::to_string(INDEX_VERSION));
+    }
+
+    RouterSettings settings = settings_;
+    settings.bus_velocity = reader.Read<double>();
+    settings.bus_wait_time = reader.Read<int32_t>();
+    const auto backend = reader.Read<uint32_t>();
+    const auto graph_model = reader.Read<uint32_t>();
+    if(backend > static_cast<uint32_t>(RouterBackend::HUB_LABELS)
+       || graph_model > static_cast<uint32_t>(GraphModel::RIDES)) {
+        throw serialization::FormatError("Unknown router backend or graph model in " + path);
+    }
+    const auto loaded_backend = static_cast<RouterBackend>(backend);
+    // RouterBackend::AUTO stays as it is and stands for the backend of the file
+    if(settings.backend != RouterBackend::AUTO) {
+        settings.backend = loaded_backend;
+    }
+    settings.graph_model = static_cast<GraphModel>(graph_model);
+    const auto max_geo_velocity = reader.Read<double>();
+
+    auto stop_names = reader.ReadStrings();
+    const auto stop_coordinates = reader.ReadArray<geo::Coordinates>();
+    auto bus_names = reader.ReadStrings();
+    const auto edge_infos = reader.ReadArray<EdgeInfo>();
+    const auto ride_vertex_stops = reader.ReadArray<size_t>();
+    const auto vertex_count = reader.Read<uint64_t>();
+    const auto edges = reader.ReadArray<graph::Edge<EdgeWeight>>();
+
+    const size_t stop_count = stop_names.size();
+    const size_t ride_vertex_count = ride_vertex_stops.end() - ride_vertex_stops.begin();
+    const bool metadata_fits = size_t(stop_coordinates.end() - stop_coordinates.begin()) == stop_count
+        && vertex_count == (settings.graph_model == GraphModel::STOP_PAIRS ? stop_count * 2
+                                                                           : stop_count + ride_vertex_count)
+        && edge_infos.end() - edge_infos.begin() == edges.end() - edges.begin()
+        && std::all_of(edge_infos.begin(), edge_infos.end(), [&bus_names](const EdgeInfo& edge_info) {
+               return edge_info.bus == NO_BUS || edge_info.bus < bus_names.size();
+           })
+        && std::all_of(ride_vertex_stops.begin(), ride_vertex_stops.end(), [stop_count](size_t stop) {
+               return stop < stop_count;
+           });
+    if(!metadata_fits) {
+        throw serialization::FormatError("Route metadata does not match the stops in " + path);
+    }
+
+    Reset();
+    settings_ = std::move(settings);
+    backend_ = loaded_backend;
+    max_geo_velocity_ = max_geo_velocity;
+    stop_names_ = std::move(stop_names);
+    for(size_t id = 0; id < stop_count; ++id) {
+        nodes_map_.emplace(stop_names_[id], id);
+    }
+    stop_coordinates_.assign(stop_coordinates.begin(), stop_coordinates.end());
+    bus_names_ = std::move(bus_names);
+    edge_infos_.assign(edge_infos.begin(), edge_infos.end());
+    ride_vertex_stops_.assign(ride_vertex_stops.begin(), ride_vertex_stops.end());
+
+    const auto read_vector = [&reader](auto& values) {
+        using Value = typename std::decay_t<decltype(values)>::value_type;
+        const auto saved_values = reader.ReadArray<Value>();
+        values.assign(saved_values.begin(), saved_values.end());
+    };
+    try {
+        graph_.emplace(vertex_count, std::vector<graph::Edge<EdgeWeight>>(edges.begin(), edges.end()));
+        components_ = graph::ConnectedComponents<EdgeWeight>(*graph_);
+        switch(backend_) {
+            case RouterBackend::ALL_PAIRS: {
+                const auto table = reader.ReadArray<char>();
+                router_.emplace<graph::Router<EdgeWeight>>(*graph_, table.begin(), table.end() - table.begin());
+                break;
+            }
+            case RouterBackend::CONTRACTION_HIERARCHIES: {
+                using Hierarchy = graph::ContractionHierarchy<EdgeWeight>;
+                Hierarchy::Index index;
+                read_vector(index.edges);
+                read_vector(index.forward_offsets);
+                read_vector(index.forward_arcs);
+                read_vector(index.backward_offsets);
+                read_vector(index.backward_arcs);
+                router_.emplace<Hierarchy>(*graph_, std::move(index));
+                break;
+            }
+            case RouterBackend::HUB_LABELS: {
+                using HubLabels = graph::HubLabels<EdgeWeight>;
+                HubLabels::Index index;
+                read_vector(index.hubs);
+                read_vector(index.forward_offsets);
+                read_vector(index.forward_entries);
+                read_vector(index.backward_offsets);
+                read_vector(index.backward_entries);
+                router_.emplace<HubLabels>(*graph_, std::move(index));
+                break;
+            }
+            case RouterBackend::ALT: {
+                graph::Landmarks<EdgeWeight>::Index index;
+                read_vector(index.landmarks);
+                read_vector(index.from_landmarks);
+                read_vector(index.to_landmarks);
+                landmarks_.emplace(*graph_, std::move(index));
+                EmplaceLandmarkRouter();
+                break;
+            }
+            default:
+                BuildRouter();
+                break;
+        }
+    } catch(...) {
+        Reset();
+        throw;
+    }
+
+    mapped_index_ = std::move(mapped_index);
+    return true;
+}
+
+// Vertex 2 * id + 1 is "arrived at the stop", vertex 2 * id is "waited and ready to board".
+// Every pair of stops (i, j) of a bus gets an edge 2 * i -> 2 * j + 1 unless another bus is faster.
+//
+// Every bus lists its candidate pairs on its own, in parallel; the lists are then bucketed
+// by source stop in bus order and every bucket keeps the fastest candidate per target stop,
+// the earliest one on ties. That is what a serial pass over the buses would pick, so the
+// graph is the same whatever the thread count.
+void TransportRouter::BuildStopPairsGraph(const std::vector<BusRoute>& bus_routes) {
+    struct Candidate {
+        size_t from;
+        size_t to;
+        double weight;
+        uint32_t bus;
+        uint32_t count;
+    };
+    const auto by_target = [](const Candidate& lhs, const Candidate& rhs) {
+        return lhs.to < rhs.to;
+    };
+    // keeps the first of the fastest candidates of every group with the same stops in a range
+    // stably sorted by stops, moving them to its front; returns their end
+    const auto keep_fastest = [](auto begin, auto end) {
+        auto out = begin;
+        for(auto it = begin; it != end; ++it) {
+            if(out != begin && std::prev(out)->from == it->from && std::prev(out)->to == it->to) {
+                if(it->weight < std::prev(out)->weight) {
+                    *std::prev(out) = *it;
+                }
+            } else {
+                *out++ = *it;
+            }
+        }
+        return out;
+    };
+
+    auto& thread_pool = parallel::DefaultThreadPool();
+    const size_t stop_count = stop_names_.size();
+
+    std::vector<std::vector<Candidate>> bus_candidates(bus_routes.size());
+    thread_pool.ParallelFor(bus_routes.size(), [&](size_t bus) {
+        const auto& stops = bus_routes[bus].stops;
+        const auto& weights_from_first_stop = bus_routes[bus].times_from_first_stop;
+        auto& candidates = bus_candidates[bus];
+        candidates.reserve(stops.size() * (stops.size() - 1) / 2);
+        for(size_t i = 0; i + 1 < stops.size(); ++i) {
+            for(size_t j = i + 1; j < stops.size(); ++j) {
+                candidates.push_back({stops[i], stops[j], weights_from_first_stop[j] - weights_from_first_stop[i],
+                                      static_cast<uint32_t>(bus), static_cast<uint32_t>(j - i)});
+            }
+        }
+        // a bus passing a stop twice lists some pairs several times
+        std::stable_sort(candidates.begin(), candidates.end(), [](const Candidate& lhs, const Candidate& rhs) {
+            return std::pair(lhs.from, lhs.to) < std::pair(rhs.from, rhs.to);
+        });
+        candidates.erase(keep_fastest(candidates.begin(), candidates.end()), candidates.end());
+    });
+
+    std::vector<size_t> offsets(stop_count + 1, 0);
+    for(const auto& candidates: bus_candidates) {
+        for(const auto& candidate: candidates) {
+            ++offsets[candidate.from + 1];
+        }
+    }
+    for(size_t stop = 0; stop < stop_count; ++stop) {
+        offsets[stop + 1] += offsets[stop];
+    }
+    std::vector<Candidate> by_source(offsets.back());
+    {
+        auto positions = offsets;
+        for(auto& candidates: bus_candidates) {
+            for(const auto& candidate: candidates) {
+                by_source[positions[candidate.from]++] = candidate;
+            }
+            candidates = {};
+        }
+    }
+
+    std::vector<size_t> kept_counts(stop_count);
+    thread_pool.ParallelFor(stop_count, [&](size_t stop) {
+        const auto begin = by_source.begin() + offsets[stop];
+        const auto end = by_source.begin() + offsets[stop + 1];
+        std::stable_sort(begin, end, by_target);
+        kept_counts[stop] = keep_fastest(begin, end) - begin;
+    });
+
+    graph_.emplace(stop_count * 2);
+
+    auto wait_time = double(settings_.bus_wait_time);
+    for(size_t id = 0; id < stop_count; ++id) {
+        graph_->AddEdge({id * 2 + 1, id * 2, ToEdgeWeight(wait_time)});
+        edge_infos_.push_back({wait_time, NO_BUS, 0});
+    }
+    for(size_t stop = 0; stop < stop_count; ++stop) {
+        for(size_t index = offsets[stop]; index < offsets[stop] + kept_counts[stop]; ++index) {
+            const auto& candidate = by_source[index];
+            graph_->AddEdge({candidate.from * 2, candidate.to * 2 + 1, ToEdgeWeight(candidate.weight)});
+            edge_infos_.push_back({candidate.weight, candidate.bus, candidate.count});
+        }
+    }
+}
+
+// Vertices [0, stop count) are the stops, followed by one ride vertex per position of every bus.
+// Boarding a bus (stop -> ride) costs the wait time, riding to the next position costs
+// the segment time, and getting off (ride -> stop) is free.
+void TransportRouter::BuildRidesGraph(const std::vector<BusRoute>& bus_routes) {
+    for(const auto& bus_route: bus_routes) {
+        ride_vertex_stops_.insert(ride_vertex_stops_.end(), bus_route.stops.begin(), bus_route.stops.end());
+    }
+
+    graph_.emplace(stop_names_.size() + ride_vertex_stops_.size());
+
+    auto wait_time = double(settings_.bus_wait_time);
+    graph::VertexId ride_vertex = stop_names_.size();
+    for(uint32_t bus = 0; bus < bus_routes.size(); ++bus) {
+        const auto& stops = bus_routes[bus].stops;
+        const auto& times = bus_routes[bus].times_from_first_stop;
+        for(size_t i = 0; i < stops.size(); ++i, ++ride_vertex) {
+            if(i + 1 < stops.size()) {
+                graph_->AddEdge({stops[i], ride_vertex, ToEdgeWeight(wait_time)});
+                edge_infos_.push_back({wait_time, NO_BUS, 0});
+                const double time = times[i + 1] - times[i];
+                graph_->AddEdge({ride_vertex, ride_vertex + 1, ToEdgeWeight(time)});
+                edge_infos_.push_back({time, bus, 1});
+            }
+            if(i > 0) {
+                graph_->AddEdge({ride_vertex, stops[i], 0});
+                edge_infos_.push_back({0, bus, 0});
+            }
+        }
+    }
+}
+
+graph::VertexId TransportRouter::GetStopVertex(size_t stop_id) const {
+    return settings_.graph_model == GraphModel::STOP_PAIRS ? stop_id * 2 + 1 : stop_id;
+}
+
+size_t TransportRouter::GetVertexStop(graph::VertexId vertex) const {
+    if(settings_.graph_model == GraphModel::STOP_PAIRS) {
+        return vertex >> 1;
+    }
+    return vertex < stop_names_.size() ? vertex : ride_vertex_stops_[vertex - stop_names_.size()];
+}
+
+TransportRouter::EdgeWeight TransportRouter::ToEdgeWeight(double minutes) {
+    if constexpr(std::is_integral_v<EdgeWeight>) {
+        return static_cast<EdgeWeight>(std::ceil(minutes * WEIGHT_UNITS_PER_MINUTE));
+    } else {
+        return static_cast<EdgeWeight>(minutes);
+    }
+}
+
+double TransportRouter::ToMinutes(EdgeWeight weight) {
+    return static_cast<double>(weight) / WEIGHT_UNITS_PER_MINUTE;
+}
+
+TransportRouter::EdgeWeight TransportRouter::GetTimeLowerBound(graph::VertexId from, graph::VertexId to) const {
+    if(max_geo_velocity_ == 0 || max_geo_velocity_ == std::numeric_limits<double>::infinity()) {
+        return 0;
+    }
+    auto distance = geo::ComputeDistance(stop_coordinates_[GetVertexStop(from)],
+                                         stop_coordinates_[GetVertexStop(to)]);
+    // a hair below the exact bound, so that rounding in ComputeDistance cannot break consistency
+    const double minutes = distance / max_geo_velocity_ * (1 - 1e-9);
+    if constexpr(std::is_integral_v<EdgeWeight>) {
+        // edge weights are rounded up and the bound down, which keeps the bound consistent
+        return static_cast<EdgeWeight>(std::floor(minutes * WEIGHT_UNITS_PER_MINUTE));
+    } else {
+        return static_cast<EdgeWeight>(minutes);
+    }
+}
+
+std::optional<TransportRouter::Route> TransportRouter::GetRoute(std::string_view from, std::string_view to,
+                                                               const RouteOverrides& overrides) const {
+    std::optional<TransportRouter::Route> result_route;
     if(!nodes_map_.count(from) || !nodes_map_.count(to)) {
         return result_route;
     }
 
-    auto route_info = router_->BuildRoute(nodes_map_.at(from) * 2 + 1,
-                                          nodes_map_.at(to) * 2 + 1);
-    if(!route_info) {
+    const EdgeTimes edge_times = GetEdgeTimes(overrides);
+    const graph::VertexId from_vertex = GetStopVertex(nodes_map_.at(from));
+    const graph::VertexId to_vertex = GetStopVertex(nodes_map_.at(to));
+    if(!components_.MayReach(from_vertex, to_vertex)) {
+        return result_route;
+    }
+    std::optional<std::vector<graph::EdgeId>> edges;
+    if(edge_times.wait_time == settings_.bus_wait_time && edge_times.ride_time_scale == 1) {
+        if(auto route_info = BuildRoute(from_vertex, to_vertex)) {
+            edges = std::move(route_info->edges);
+        }
+    } else if(graph_) {
+        if(auto found_route = FindRoute({{from_vertex, 0}}, {{to_vertex, 0}}, edge_times)) {
+            edges = std::move(found_route->edges);
+        }
+    }
+    if(!edges) {
         return result_route;
     }
 
     result_route.emplace();
-    result_route->total_time = route_info->weight;
+    result_route->total_time = 0;
+    for(auto edge_id: *edges) {
+        result_route->total_time += edge_times.GetTime(edge_infos_[edge_id]);
+    }
 
-    for(auto edge_id: route_info->edges) {
-        const auto& edge = graph_->GetEdge(edge_id);
-        // the first node is odd -> wait for bus
-        if(edge.from & 1) {
-            result_route->items.emplace_back(Route::WaitItem{stop_names_[edge.from >> 1], edge.weight});
+    FillRouteItems(*edges, edge_times, *result_route);
+
+    return result_route;
+}
+
+std::optional<TransportRouter::RouteBetweenEnds> TransportRouter::GetRoute(const std::vector<RouteEnd>& from,
+                                                                          const std::vector<RouteEnd>& to,
+                                                                          const RouteOverrides& overrides) const {
+    const EdgeTimes edge_times = GetEdgeTimes(overrides);
+    // the ends at known stops, as indices in from and to, and their vertices paired with the walks
+    const auto collect_ends = [this](const std::vector<RouteEnd>& ends, std::vector<size_t>& positions,
+                                     std::vector<std::pair<graph::VertexId, double>>& vertices) {
+        for(size_t i = 0; i < ends.size(); ++i) {
+            if(auto node_it = nodes_map_.find(ends[i].stop_name); node_it != nodes_map_.end()) {
+                positions.push_back(i);
+                vertices.emplace_back(GetStopVertex(node_it->second), ends[i].walk_time);
+            }
+        }
+    };
+    std::vector<size_t> source_positions, target_positions;
+    std::vector<std::pair<graph::VertexId, double>> sources, targets;
+    collect_ends(from, source_positions, sources);
+    collect_ends(to, target_positions, targets);
+
+    const bool may_reach = std::any_of(sources.begin(), sources.end(), [this, &targets](const auto& source) {
+        return std::any_of(targets.begin(), targets.end(), [this, &source](const auto& target) {
+            return components_.MayReach(source.first, target.first);
+        });
+    });
+    if(!may_reach) {
+        return std::nullopt;
+    }
+    auto found_route = FindRoute(sources, targets, edge_times);
+    if(!found_route) {
+        return std::nullopt;
+    }
+
+    RouteBetweenEnds result{from[source_positions[found_route->source]], to[target_positions[found_route->target]], {}};
+    result.route.total_time = result.from.walk_time + result.to.walk_time;
+    for(auto edge_id: found_route->edges) {
+        result.route.total_time += edge_times.GetTime(edge_infos_[edge_id]);
+    }
+    FillRouteItems(found_route->edges, edge_times, result.route);
+    return result;
+}
+
+std::vector<std::vector<std::optional<double>>> TransportRouter::GetTravelTimes(
+        const std::vector<std::string_view>& from, const std::vector<std::string_view>& to) const {
+    std::vector<std::vector<std::optional<double>>> travel_times(from.size(), std::vector<std::optional<double>>(to.size()));
+
+    // unknown stops keep their rows and columns empty
+    const auto collect_vertices = [this](const std::vector<std::string_view>& stops,
+                                         std::vector<graph::VertexId>& vertices, std::vector<size_t>& positions) {
+        for(size_t i = 0; i < stops.size(); ++i) {
+            if(auto node_it = nodes_map_.find(stops[i]); node_it != nodes_map_.end()) {
+                vertices.push_back(GetStopVertex(node_it->second));
+                positions.push_back(i);
+            }
         }
-        // the first node is even -> move from stop to other stop
-        else {
-            const auto& weight_info = weight_map_.at({edge.from >> 1, edge.to >> 1});
-            result_route->items.emplace_back(Route::BusItem{weight_info.bus_name, weight_info.count, weight_info.weight});
+    };
+    std::vector<graph::VertexId> sources, targets;
+    std::vector<size_t> source_positions, target_positions;
+    collect_vertices(from, sources, source_positions);
+    collect_vertices(to, targets, target_positions);
+    if(sources.empty() || targets.empty()) {
+        return travel_times;
+    }
+
+    auto weights = std::visit([&sources, &targets](const auto& router) -> std::vector<std::optional<EdgeWeight>> {
+        if constexpr (std::is_same_v<std::decay_t<decltype(router)>, std::monostate>) {
+            return std::vector<std::optional<EdgeWeight>>(sources.size() * targets.size());
+        } else {
+            return router.BuildWeightMatrix(sources, targets);
         }
+    }, router_);
+
+    for(size_t i = 0; i < sources.size(); ++i) {
+        for(size_t j = 0; j < targets.size(); ++j) {
+            if(const auto& weight = weights[i * targets.size() + j]) {
+                travel_times[source_positions[i]][target_positions[j]] = ToMinutes(*weight);
+            }
+        }
+    }
+    return travel_times;
+}
+
+std::optional<std::vector<TransportRouter::ReachableStop>>
+TransportRouter::GetReachableStops(std::string_view from, double max_time) const {
+    auto node_it = nodes_map_.find(from);
+    if(node_it == nodes_map_.end()) {
+        return std::nullopt;
     }
 
-    return result_route;
+    std::vector<ReachableStop> reachable_stops;
+    if(max_time < 0) {
+        return reachable_stops;
+    }
+    // the exact time of every route, summed along the search tree: a route's start comes first
+    std::unordered_map<graph::VertexId, double> times;
+    for(const auto& reached: graph::FindVerticesWithin(*graph_, GetStopVertex(node_it->second),
+                                                       ToEdgeWeight(max_time))) {
+        double time = 0;
+        if(reached.prev_edge != graph::SearchState<EdgeWeight>::NO_EDGE) {
+            time = times.at(graph_->GetEdge(reached.prev_edge).from) + edge_infos_[reached.prev_edge].time;
+        }
+        times.emplace(reached.vertex, time);
+        // only the vertices standing for the stops themselves, not waiting or riding states
+        const size_t stop_id = GetVertexStop(reached.vertex);
+        if(GetStopVertex(stop_id) == reached.vertex && time <= max_time) {
+            reachable_stops.push_back({stop_names_[stop_id], time});
+        }
+    }
+    // rounding of the edge weights may swap routes of nearly the same time
+    std::stable_sort(reachable_stops.begin(), reachable_stops.end(),
+                     [](const ReachableStop& lhs, const ReachableStop& rhs) {
+                         return lhs.time < rhs.time;
+                     });
+    return reachable_stops;
+}
+
+// Works for both graph models: a bus edge right after another one continues the same ride,
+// which only happens with GraphModel::RIDES, where every span is an edge of its own.
+void TransportRouter::FillRouteItems(const std::vector<graph::EdgeId>& edges, const EdgeTimes& edge_times,
+                                     Route& route) const {
+    for(auto edge_id: edges) {
+        const auto& edge_info = edge_infos_[edge_id];
+        const double time = edge_times.GetTime(edge_info);
+        if(edge_info.bus == NO_BUS) {
+            route.items.emplace_back(Route::WaitItem{stop_names_[GetVertexStop(graph_->GetEdge(edge_id).from)], time});
+        } else if(edge_info.span_count == 0) {
+            continue;
+        } else if(auto* bus_item = std::get_if<Route::BusItem>(&route.items.back())) {
+            bus_item->span_count += edge_info.span_count;
+            bus_item->time += time;
+        } else {
+            route.items.emplace_back(Route::BusItem{bus_names_[edge_info.bus], static_cast<int>(edge_info.span_count),
+                                                    time});
+        }
+    }
+}
+
+TransportRouter::EdgeTimes TransportRouter::GetEdgeTimes(const RouteOverrides& overrides) const {
+    if(overrides.bus_velocity && !(*overrides.bus_velocity > 0)) {
+        throw std::invalid_argument("Bus velocity should be positive");
+    }
+    if(overrides.bus_wait_time && *overrides.bus_wait_time < 0) {
+        throw std::invalid_argument("Bus wait time should not be negative");
+    }
+    return {double(overrides.bus_wait_time.value_or(settings_.bus_wait_time)),
+            settings_.bus_velocity / overrides.bus_velocity.value_or(settings_.bus_velocity)};
+}
+
+std::optional<TransportRouter::FoundRoute> TransportRouter::FindRoute(
+        const std::vector<std::pair<graph::VertexId, double>>& sources,
+        const std::vector<std::pair<graph::VertexId, double>>& targets, const EdgeTimes& edge_times) const {
+    // a vertex listed twice keeps the earliest of its smallest times
+    std::unordered_map<graph::VertexId, size_t> target_indices;
+    for(size_t i = 0; i < targets.size(); ++i) {
+        auto [target_it, inserted] = target_indices.emplace(targets[i].first, i);
+        if(!inserted && targets[i].second < targets[target_it->second].second) {
+            target_it->second = i;
+        }
+    }
+
+    static thread_local graph::SearchState<double> search;
+    search.Prepare(graph_->GetVertexCount());
+    for(const auto& [vertex, time]: sources) {
+        search.Relax(vertex, time, graph::SearchState<double>::NO_EDGE);
+    }
+
+    // a vertex settled no earlier than the best route found so far cannot improve on it
+    std::optional<graph::VertexId> best_target;
+    double best_time = 0;
+    graph::SearchState<double>::QueueItem item;
+    while(search.PopSettled(item) && (!best_target || item.weight < best_time)) {
+        if(auto target_it = target_indices.find(item.vertex); target_it != target_indices.end()) {
+            const double time = item.weight + targets[target_it->second].second;
+            if(!best_target || time < best_time) {
+                best_target = item.vertex;
+                best_time = time;
+            }
+        }
+        for(const graph::EdgeId edge_id: graph_->GetIncidentEdges(item.vertex)) {
+            search.Relax(graph_->GetEdge(edge_id).to, item.weight + edge_times.GetTime(edge_infos_[edge_id]), edge_id);
+        }
+    }
+    if(!best_target) {
+        return std::nullopt;
+    }
+
+    FoundRoute found_route;
+    found_route.target = target_indices.at(*best_target);
+    graph::VertexId start = *best_target;
+    for(auto edge_id = search.GetPrevEdge(start); edge_id != graph::SearchState<double>::NO_EDGE;
+        edge_id = search.GetPrevEdge(start)) {
+        found_route.edges.push_back(edge_id);
+        start = graph_->GetEdge(edge_id).from;
+    }
+    std::reverse(found_route.edges.begin(), found_route.edges.end());
+    // the source the route starts with: the first one of its vertex with the smallest time
+    const auto source_it = std::find(sources.begin(), sources.end(), std::pair(start, search.GetWeight(start)));
+    found_route.source = source_it - sources.begin();
+    return found_route;
+}
+
+std::optional<graph::Router<TransportRouter::EdgeWeight>::RouteInfo>
+TransportRouter::BuildRoute(graph::VertexId from, graph::VertexId to) const {
+    return std::visit([from, to](const auto& router) -> std::optional<graph::Router<EdgeWeight>::RouteInfo> {
+        if constexpr (std::is_same_v<std::decay_t<decltype(router)>, std::monostate>) {
+            return std::nullopt;
+        } else {
+            return router.BuildRoute(from, to);
+        }
+    }, router_);
+}
+
+size_t TransportRouter::GetLastSettledCount() const {
+    return std::visit([](const auto& router) -> size_t {
+        using RouterType = std::decay_t<decltype(router)>;
+        if constexpr (std::is_same_v<RouterType, std::monostate> || std::is_same_v<RouterType, graph::Router<EdgeWeight>>
+                      || std::is_same_v<RouterType, graph::HubLabels<EdgeWeight>>) {
+            return 0;
+        } else {
+            return RouterType::GetLastSettledCount();
+        }
+    }, router_);
 }
 
 void TransportRouter::Reset() {
     stop_names_.clear();
     nodes_map_.clear();
-    router_.reset();
+    bus_names_.clear();
+    edge_infos_.clear();
+    stop_coordinates_.clear();
+    max_geo_velocity_ = 0;
+    ride_vertex_stops_.clear();
+    router_.emplace<std::monostate>();
+    landmarks_.reset();
+    components_ = {};
     graph_.reset();
+    mapped_index_.reset();
 }
 
 }
\ No newline at end of file
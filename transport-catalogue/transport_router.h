@@ -1,20 +1,76 @@
 #pragma once
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
 #include <string_view>
 #include <vector>
 #include <variant>
 #include <optional>
+#include <type_traits>
+#include <utility>
 
 #include "router.h"
+#include "components.h"
+#include "dijkstra_router.h"
+#include "contraction_hierarchy.h"
+#include "hub_labels.h"
+#include "landmarks.h"
 #include "domain.h"
+#include "geo.h"
+#include "serialization.h"
+#include "thread_pool.h"
 
 namespace tc::routing {
 
+// AddBus and RemoveBus update the ALL_PAIRS table in place; every other backend is rebuilt
+// from scratch over the new graph, at the cost of its preprocessing.
+enum class RouterBackend {
+    ALL_PAIRS,               // precomputed table, O(V^2) memory, constant-time lookups
+    DIJKSTRA,                // graph only, one search per query
+    BIDIRECTIONAL_DIJKSTRA,  // graph and its reverse, searches from both ends per query
+    A_STAR,                  // graph only, search directed by great-circle distance to the target
+    CONTRACTION_HIERARCHIES, // graph plus shortcuts, bidirectional upward search per query
+    ALT,                     // graph plus route weights to and from a few landmarks, O(landmarks * V),
+                             // search directed by the landmark bounds, which also see the waits
+    HUB_LABELS,              // graph plus a forward and a backward hub label per vertex,
+                             // a merge of two labels per query
+    AUTO                     // ALL_PAIRS, CONTRACTION_HIERARCHIES or DIJKSTRA: the first whose
+                             // estimated memory fits RouterSettings::memory_budget
+};
+
+enum class GraphModel {
+    STOP_PAIRS,  // two vertices per stop, an edge for every pair of stops on a bus: O(k^2) per bus
+    RIDES        // a vertex per stop and per (bus, stop) position, O(k) edges per bus
+};
+
+enum class StopOrder {
+    FIRST_APPEARANCE,  // stop ids in the order the buses mention the stops
+    HILBERT_CURVE      // stop ids along a Hilbert curve over the coordinates: nearby stops get nearby ids
+};
+
+struct RouterSettings {
+    double bus_velocity = 0;
+    int bus_wait_time = 0;
+    RouterBackend backend = RouterBackend::ALL_PAIRS;
+    GraphModel graph_model = GraphModel::STOP_PAIRS;
+    // Numbering of the graph vertices; the spatial one keeps the rows, labels and search state
+    // of neighbouring stops close in memory. Stops are still addressed by name.
+    StopOrder stop_order = StopOrder::FIRST_APPEARANCE;
+    // RouterBackend::ALT only
+    size_t landmark_count = 16;
+    // RouterBackend::AUTO only, in bytes
+    size_t memory_budget = size_t(1) << 30;
+    // When set, SetData keeps the built index in this file and maps it back instead of
+    // rebuilding as long as the network and the settings above stay the same. A file that
+    // cannot be read is rebuilt and rewritten; one that cannot be written is skipped.
+    std::string index_file;
+};
+
 class TransportRouter {
 public:
-    struct RouterSettings {
-        double bus_velocity;
-        int bus_wait_time;
-    };
+    using RouterSettings = routing::RouterSettings;
 
     struct Route {
         struct WaitItem {
@@ -32,37 +88,232 @@ public:
         std::vector<std::variant<WaitItem, BusItem>> items;
     };
 
+    // Settings a single GetRoute replaces without rebuilding the index.
+    struct RouteOverrides {
+        std::optional<int> bus_wait_time;
+        // meters per minute, as RouterSettings::bus_velocity
+        std::optional<double> bus_velocity;
+    };
+
+    // A stop a route may start or end at, with the time to walk between it and the actual
+    // origin or destination.
+    struct RouteEnd {
+        std::string_view stop_name;
+        double walk_time;
+    };
+
+    // A route between the ends it starts and ends at; the walks count in route.total_time.
+    struct RouteBetweenEnds {
+        RouteEnd from;
+        RouteEnd to;
+        Route route;
+    };
+
+    struct ReachableStop {
+        std::string_view stop_name;
+        double time;
+    };
+
     explicit TransportRouter(RouterSettings settings = {});
 
     TransportRouter& SetSettings(RouterSettings settings);
 
+    // A bus has a name and a range of stops, each with a name and coordinates; distance_getter takes
+    // two such stops and returns the road distance between them as an optional.
+    // Buses are processed on the default thread pool, so distance_getter is called concurrently
+    // and must be safe to call from several threads. The result does not depend on the thread count.
     template <typename BusInputIt, typename StopInputIt, typename DistanceGetter>
     TransportRouter& SetData(BusInputIt buses_begin, BusInputIt buses_end,
                              StopInputIt stops_begin, StopInputIt stops_end,
                              const DistanceGetter& distance_getter);
 
-    [[nodiscard]] std::optional<Route> GetRoute(std::string_view from, std::string_view to) const;
+    // Adds a bus, or replaces the one with the same name in its place. The graph is rebuilt, the
+    // routing index is updated in place for RouterBackend::ALL_PAIRS and rebuilt from scratch for
+    // the other backends. Names are referenced, not copied, as with SetData.
+    template <typename Bus, typename DistanceGetter>
+    TransportRouter& AddBus(const Bus& bus, const DistanceGetter& distance_getter);
 
-private:
-    void Reset();
+    // As AddBus, the index is only updated in place for RouterBackend::ALL_PAIRS.
+    TransportRouter& RemoveBus(std::string_view name);
+
+    // Without overrides the backend answers; with them graph_ is searched on demand with edge times
+    // recomputed from the overridden settings.
+    [[nodiscard]] std::optional<Route> GetRoute(std::string_view from, std::string_view to,
+                                                const RouteOverrides& overrides = {}) const;
+
+    // The fastest route from any end of `from` to any end of `to`, walks included, found by
+    // a single search of graph_ started from all of `from` at once. Unknown stops are skipped.
+    [[nodiscard]] std::optional<RouteBetweenEnds> GetRoute(const std::vector<RouteEnd>& from,
+                                                          const std::vector<RouteEnd>& to,
+                                                          const RouteOverrides& overrides = {}) const;
+
+    // Total times of the routes from every stop of `from` to every stop of `to`, without the routes
+    // themselves: result[i][j] is the time from from[i] to to[j], nullopt if there is no route.
+    [[nodiscard]] std::vector<std::vector<std::optional<double>>> GetTravelTimes(
+            const std::vector<std::string_view>& from, const std::vector<std::string_view>& to) const;
+
+    // Stops that can be reached from `from` within max_time, the origin included, with the time
+    // of the fastest route to each, fastest first. nullopt if the origin is unknown.
+    [[nodiscard]] std::optional<std::vector<ReachableStop>> GetReachableStops(std::string_view from,
+                                                                            double max_time) const;
+
+    // Writes the graph, the names, the route metadata and the backend's index to a versioned
+    // binary file.
+    void SaveIndex(const std::string& path) const;
+    // Replaces the router's state and settings with a file written by SaveIndex. The file is
+    // mapped, but only the stop and bus names and the all-pairs route table are used in place.
+    // The graph edges, the edge metadata, the stop coordinates and the hierarchy, hub label
+    // and landmark arrays are copied out of the mapping into the router's own vectors.
+    void LoadIndex(const std::string& path);
+
+    // Vertices settled by the last GetRoute on the calling thread; 0 for the ALL_PAIRS and
+    // HUB_LABELS backends, which do not search.
+    [[nodiscard]] size_t GetLastSettledCount() const;
 
 private:
+    // Weight of the graph edges; any arithmetic type works, e.g. uint32_t. Floating-point weights
+    // are minutes, integral ones count hundredths of a second, rounded up. Route, item and
+    // isochrone times are summed from the exact times of EdgeInfo either way; travel time
+    // matrices are summed from the weights, so integral weights make them up to a unit per edge longer.
     using EdgeWeight = double;
+    static constexpr double WEIGHT_UNITS_PER_MINUTE = std::is_integral_v<EdgeWeight> ? 6000 : 1;
+
+    // Rounds up to a whole unit, so that no path weighs less than its exact time.
+    static EdgeWeight ToEdgeWeight(double minutes);
+    static double ToMinutes(EdgeWeight weight);
 
-    struct WeightInfo {
-        double weight = 0;
-        std::string_view bus_name;
-        int count = 0;
+    // Stops of a bus as stop ids with the riding time from the first stop to each of them.
+    struct BusRoute {
+        std::string_view name;
+        std::vector<size_t> stops;
+        std::vector<double> times_from_first_stop;
+    };
+
+    // A bus as given to SetData or AddBus, independent of the stop ids.
+    struct BusLine {
+        std::string_view name;
+        std::vector<std::string_view> stops;
+        std::vector<geo::Coordinates> stop_coordinates;
+        std::vector<double> times_from_first_stop;
+        // meters per minute, see max_geo_velocity_
+        double max_geo_velocity = 0;
+    };
+
+    // What a graph edge stands for in a route description. An edge is either a wait
+    // (bus == NO_BUS) or a ride at the velocity of the settings, never both.
+    struct EdgeInfo {
+        double time;
+        uint32_t bus;         // index in bus_names_, NO_BUS for waiting at a stop
+        uint32_t span_count;  // 0 for getting off a bus (GraphModel::RIDES)
+    };
+    static constexpr uint32_t NO_BUS = std::numeric_limits<uint32_t>::max();
+
+    // Edge times under a wait time and a velocity other than the ones the graph was built with:
+    // waits take the new wait time, ride times scale with the velocity.
+    struct EdgeTimes {
+        double wait_time = 0;
+        double ride_time_scale = 1;
+
+        double GetTime(const EdgeInfo& edge_info) const {
+            return edge_info.bus == NO_BUS ? wait_time : edge_info.time * ride_time_scale;
+        }
     };
 
+    // A route found by FindRoute: its edges and the source and the target it joins, as indices
+    // in the arguments.
+    struct FoundRoute {
+        std::vector<graph::EdgeId> edges;
+        size_t source;
+        size_t target;
+    };
+
+    template <typename Bus, typename DistanceGetter>
+    BusLine MakeBusLine(const Bus& bus, const DistanceGetter& distance_getter) const;
+
+    void Reset();
+
+    // Numbers the stops of bus_lines_ as settings_.stop_order says and returns the buses in stop ids.
+    std::vector<BusRoute> AssignStops();
+    // Renumbers the stops along a Hilbert curve over their coordinates.
+    void SortStopsAlongHilbertCurve(std::vector<BusRoute>& bus_routes);
+
+    // Replaces, adds (if absent) or, with no line, removes the named bus, then rebuilds
+    // the graph and the routing index. RouterBackend::AUTO is resolved again; only an all-pairs
+    // table that stays all-pairs is updated in place, any other index is built from scratch.
+    void UpdateBusLine(std::string_view name, std::optional<BusLine> line);
+
+    // Sets backend_ to settings_.backend or, for RouterBackend::AUTO, to what it stands for
+    // with these buses.
+    void ResolveBackend(const std::vector<BusRoute>& bus_routes);
+    // What RouterBackend::AUTO stands for with these buses; the graph does not need to be built.
+    RouterBackend ChooseBackend(const std::vector<BusRoute>& bus_routes) const;
+
+    // Loads the index from settings_.index_file if it was built from the same data,
+    // otherwise builds it and, with an index file set, tries to save it there.
+    void BuildIndex(std::vector<BusRoute> bus_routes);
+    uint64_t ComputeFingerprint(const std::vector<BusRoute>& bus_routes) const;
+    void SaveIndex(const std::string& path, uint64_t fingerprint) const;
+    // Leaves the state untouched and returns false if the file holds another fingerprint.
+    bool LoadIndex(const std::string& path, std::optional<uint64_t> fingerprint);
+
+    void BuildGraph(const std::vector<BusRoute>& bus_routes);
+    void BuildRouter();
+    // An A* router over graph_ directed by landmarks_.
+    void EmplaceLandmarkRouter();
+    void BuildStopPairsGraph(const std::vector<BusRoute>& bus_routes);
+    void BuildRidesGraph(const std::vector<BusRoute>& bus_routes);
+
+    graph::VertexId GetStopVertex(size_t stop_id) const;
+    size_t GetVertexStop(graph::VertexId vertex) const;
+
+    // Great-circle distance between the stops of two vertices over the fastest speed seen
+    // on any bus segment: never more than the real travel time.
+    EdgeWeight GetTimeLowerBound(graph::VertexId from, graph::VertexId to) const;
+
+    std::optional<graph::Router<EdgeWeight>::RouteInfo> BuildRoute(graph::VertexId from, graph::VertexId to) const;
+    // Throws if the overrides are invalid.
+    EdgeTimes GetEdgeTimes(const RouteOverrides& overrides) const;
+    // Dijkstra's search over graph_ weighted by edge_times instead of the edge weights, from all
+    // the sources at once. Every source starts with the time paired with it, and every target adds
+    // its time at the end; the route with the smallest sum wins.
+    std::optional<FoundRoute> FindRoute(const std::vector<std::pair<graph::VertexId, double>>& sources,
+                                        const std::vector<std::pair<graph::VertexId, double>>& targets,
+                                        const EdgeTimes& edge_times) const;
+
+    void FillRouteItems(const std::vector<graph::EdgeId>& edges, const EdgeTimes& edge_times, Route& route) const;
+
+private:
     RouterSettings settings_;
+    // the backend in use: settings_.backend with RouterBackend::AUTO resolved
+    RouterBackend backend_ = RouterBackend::ALL_PAIRS;
+    // in SetData order; empty after LoadIndex, which has no buses to update
+    std::vector<BusLine> bus_lines_;
+    bool has_bus_lines_ = true;
+    // set when the state was loaded from an index file; names and the route table point into it,
+    // so it is declared before them and outlives them
+    std::unique_ptr<serialization::MappedFile> mapped_index_;
     std::vector<std::string_view> stop_names_;
     std::unordered_map<std::string_view, size_t> nodes_map_;
-    std::unordered_map<std::pair<size_t, size_t>, WeightInfo,
-            domain::OrderedPairHasher<size_t, size_t>> weight_map_;
+    std::vector<geo::Coordinates> stop_coordinates_;
+    // meters per minute; no segment covers more great-circle distance per minute of riding
+    double max_geo_velocity_ = 0;
+
+    std::vector<std::string_view> bus_names_;
+    // indexed by EdgeId, filled along with the graph
+    std::vector<EdgeInfo> edge_infos_;
+    // GraphModel::RIDES: the stop of every ride vertex, indexed by vertex id minus the stop count
+    std::vector<size_t> ride_vertex_stops_;
 
     std::optional<graph::DirectedWeightedGraph<EdgeWeight>> graph_;
-    std::optional<graph::Router<EdgeWeight>> router_;
+    // of graph_, to answer queries between vertices no route joins without searching
+    graph::ConnectedComponents<EdgeWeight> components_;
+    // RouterBackend::ALT: the lower bounds of router_
+    std::optional<graph::Landmarks<EdgeWeight>> landmarks_;
+    std::variant<std::monostate,
+                 graph::Router<EdgeWeight>,
+                 graph::DijkstraRouter<EdgeWeight>,
+                 graph::ContractionHierarchy<EdgeWeight>,
+                 graph::HubLabels<EdgeWeight>> router_;
 };
 
 template<typename BusInputIt, typename StopInputIt, typename DistanceGetter>
@@ -70,71 +321,72 @@ TransportRouter& TransportRouter::SetData(BusInputIt buses_begin, BusInputIt bus
                                           StopInputIt stops_begin, StopInputIt stops_end,
                                           const DistanceGetter& distance_getter) {
     Reset();
+    bus_lines_.clear();
+    has_bus_lines_ = true;
 
     if(buses_begin == buses_end || stops_begin == stops_end) {
         return *this;
     }
 
+    std::vector<std::decay_t<decltype(*buses_begin)>> buses;
     for(auto bus_it = buses_begin; bus_it != buses_end; ++bus_it) {
         if(bus_it->stops.size() < 2) {
             continue;
         }
-        std::vector<double> weights_from_first_stop;
-        weights_from_first_stop.reserve(bus_it->stops.size());
-        weights_from_first_stop.emplace_back(0);
-
-        for(const auto* stop: bus_it->stops){
-            if(!nodes_map_.count(stop->name)) {
-                auto id = stop_names_.size();
-                stop_names_.emplace_back(stop->name);
-                nodes_map_[stop->name] = id;
-            }
-        }
+        buses.push_back(*bus_it);
+    }
 
-        double sum_weight = 0;
-        for(size_t i = 1; i < bus_it->stops.size(); ++i) {
-            const auto* cur_stop = bus_it->stops[i];
-            const auto* prev_stop = bus_it->stops[i - 1];
-            auto distance = distance_getter(prev_stop->name, cur_stop->name);
+    bus_lines_.resize(buses.size());
+    parallel::DefaultThreadPool().ParallelFor(buses.size(), [&](size_t bus_index) {
+        bus_lines_[bus_index] = MakeBusLine(buses[bus_index], distance_getter);
+    });
 
-            sum_weight += (*distance) / settings_.bus_velocity;
-            weights_from_first_stop.emplace_back(sum_weight);
-        }
+    BuildIndex(AssignStops());
 
-        for(size_t i = 0; i < bus_it->stops.size() - 1; ++i) {
-            const auto* stop_from = bus_it->stops[i];
-            auto id_from = nodes_map_.at(stop_from->name);
-
-            for(size_t j = i + 1; j < bus_it->stops.size(); ++j) {
-                const auto* stop_to = bus_it->stops[j];
-                auto id_to = nodes_map_.at(stop_to->name);
-
-                double weight = weights_from_first_stop[j] - weights_from_first_stop[i];
-                size_t stop_count = j - i;
-
-                auto& weight_info =  weight_map_[{id_from, id_to}];
-                if(weight_info.count == 0 || weight < weight_info.weight)
-                {
-                    weight_info.weight = weight;
-                    weight_info.bus_name = bus_it->name;
-                    weight_info.count = stop_count;
-                }
-            }
-        }
-    }
+    return *this;
+}
+
+template <typename Bus, typename DistanceGetter>
+TransportRouter& TransportRouter::AddBus(const Bus& bus, const DistanceGetter& distance_getter) {
+    UpdateBusLine(bus.name, bus.stops.size() < 2 ? std::nullopt
+                                                 : std::optional<BusLine>(MakeBusLine(bus, distance_getter)));
+    return *this;
+}
 
-    graph_.emplace(stop_names_.size() * 2);
+template <typename Bus, typename DistanceGetter>
+TransportRouter::BusLine TransportRouter::MakeBusLine(const Bus& bus, const DistanceGetter& distance_getter) const {
+    BusLine bus_line;
+    bus_line.name = bus.name;
+    bus_line.stops.reserve(bus.stops.size());
+    bus_line.stop_coordinates.reserve(bus.stops.size());
+    bus_line.times_from_first_stop.reserve(bus.stops.size());
 
-    auto wait_time = double(settings_.bus_wait_time);
-    for(size_t id = 0; id < stop_names_.size(); ++id) {
-        graph_->AddEdge({id * 2 + 1, id * 2, wait_time});
-    }
-    for(const auto& [ids, weight_info]: weight_map_) {
-        graph_->AddEdge({ids.first * 2, ids.second * 2 + 1, weight_info.weight});
-    }
-    router_.emplace(*graph_);
+    // stops are taken by value: a bus may hand out views assembled on the fly
+    auto prev_stop = *bus.stops.begin();
+    bus_line.stops.emplace_back(prev_stop.name);
+    bus_line.stop_coordinates.emplace_back(prev_stop.coordinates);
+    bus_line.times_from_first_stop.emplace_back(0);
 
-    return *this;
+    double sum_weight = 0;
+    for(auto stop_it = std::next(bus.stops.begin()); stop_it != bus.stops.end(); ++stop_it) {
+        const auto cur_stop = *stop_it;
+        bus_line.stops.emplace_back(cur_stop.name);
+        bus_line.stop_coordinates.emplace_back(cur_stop.coordinates);
+        auto distance = distance_getter(prev_stop, cur_stop);
+
+        double time = (*distance) / settings_.bus_velocity;
+        sum_weight += time;
+        bus_line.times_from_first_stop.emplace_back(sum_weight);
+
+        double geo_distance = geo::ComputeDistance(prev_stop.coordinates, cur_stop.coordinates);
+        prev_stop = cur_stop;
+        if(geo_distance > 0) {
+            bus_line.max_geo_velocity = std::max(bus_line.max_geo_velocity,
+                                                 time > 0 ? geo_distance / time
+                                                          : std::numeric_limits<double>::infinity());
+        }
+    }
+    return bus_line;
 }
 
 }
\ No newline at end of file